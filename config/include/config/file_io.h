@@ -0,0 +1,45 @@
+#ifndef FILE_IO_H
+#define FILE_IO_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+typedef struct file_map
+{
+    const unsigned char *data; /* start of the mapped file contents */
+    size_t size;               /* size of the file in bytes */
+    void *handle;              /* platform specific mapping handle */
+} file_map;
+
+int file_map_open(const char *path, file_map *map);
+void file_map_close(file_map *map);
+
+/*
+** Read up to size bytes at offset from the start of an open file without
+** using the stream position, so that separate threads may read the same
+** file concurrently.  The stream must be repositioned with fseek before
+** it is read again.  Returns the number of bytes read, or -1 when
+** positioned reads are not supported, as for a pipe.  A size of zero
+** tests for support without reading.
+*/
+long file_read_at(FILE *fp, void *buf, size_t size, long offset);
+
+/*
+** Copy size bytes from offset in the file in to the stream out, leaving
+** out positioned after the copy and the position of in unchanged.  The
+** data is copied within the kernel where the platform allows, and
+** otherwise through a large buffer.  Returns the number of bytes copied,
+** which is less than size when in ends early or a write fails.  Returns
+** -1, having copied nothing, when either stream cannot be used this way,
+** as for a pipe, and also when a stream cannot be repositioned after the
+** copy, in which case part of the data may have been written.
+*/
+long file_copy(FILE *in, long offset, FILE *out, long size);
+
+/*
+** Switch an open stream, such as stdin or stdout, to binary mode so that
+** image data passes through unchanged.  Returns -1 on failure.
+*/
+int file_set_binary(FILE *fp);
+
+#endif
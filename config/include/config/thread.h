@@ -0,0 +1,29 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+/*
+** Threads, mutexes and condition variables are opaque handles so that
+** the platform headers are only needed by the implementation.  When no
+** thread support is available thread_start fails, and callers are
+** expected to do the work on the calling thread instead.
+*/
+typedef struct thread_impl *thread_handle;
+typedef struct thread_mutex_impl *thread_mutex;
+typedef struct thread_cond_impl *thread_cond;
+
+int thread_start(thread_handle *thread, void (*func)(void *), void *arg);
+void thread_join(thread_handle thread);
+int thread_count(void);
+
+int thread_mutex_create(thread_mutex *mutex);
+void thread_mutex_destroy(thread_mutex mutex);
+void thread_mutex_lock(thread_mutex mutex);
+void thread_mutex_unlock(thread_mutex mutex);
+
+int thread_cond_create(thread_cond *cond);
+void thread_cond_destroy(thread_cond cond);
+void thread_cond_wait(thread_cond cond, thread_mutex mutex);
+void thread_cond_signal(thread_cond cond);
+void thread_cond_broadcast(thread_cond cond);
+
+#endif
@@ -0,0 +1,68 @@
+message(STATUS "TGAPACK=${TGAPACK}")
+message(STATUS "OPTIONS=${OPTIONS}")
+message(STATUS "IMAGES=${IMAGES}")
+message(STATUS "GOLD_OUTPUTS=${GOLD_OUTPUTS}")
+message(STATUS "SIZES=${SIZES}")
+message(STATUS "OUTPUT_DIR=${OUTPUT_DIR}")
+
+# tgapack rewrites its inputs in place, so work on numbered copies of the
+# images, which may name the same image more than once.
+file(REMOVE_RECURSE "${OUTPUT_DIR}")
+file(MAKE_DIRECTORY "${OUTPUT_DIR}")
+list(LENGTH IMAGES count)
+math(EXPR last "${count} - 1")
+set(outputs)
+foreach(i RANGE ${last})
+    list(GET IMAGES ${i} image)
+    configure_file("${image}" "${OUTPUT_DIR}/file${i}.tga" COPYONLY)
+    list(APPEND outputs "${OUTPUT_DIR}/file${i}.tga")
+endforeach()
+
+execute_process(COMMAND "${TGAPACK}" ${OPTIONS} ${outputs}
+    OUTPUT_VARIABLE output
+    RESULT_VARIABLE result)
+message(STATUS "${output}")
+if(result)
+    message(FATAL_ERROR "Failed to execute tgapack")
+endif()
+
+# Files are reported as they finish, in any order, but the progress
+# count of the reports must run from 1 to the number of files, and each
+# file must be reported once.
+string(REGEX MATCHALL "\\[[0-9]+/[0-9]+\\] Processing TGA File: [^\n]*" reports "${output}")
+list(LENGTH reports reported)
+if(NOT reported EQUAL count)
+    message(FATAL_ERROR "${reported} files reported, expected ${count}")
+endif()
+set(n 0)
+foreach(report IN LISTS reports)
+    math(EXPR n "${n} + 1")
+    if(NOT report MATCHES "^\\[${n}/${count}\\] ")
+        message(FATAL_ERROR "Report ${n} out of order: ${report}")
+    endif()
+endforeach()
+foreach(output_file IN LISTS outputs)
+    string(REGEX MATCHALL "Processing TGA File: ${output_file}\n" found "${output}")
+    list(LENGTH found times)
+    if(NOT times EQUAL 1)
+        message(FATAL_ERROR "${output_file} reported ${times} times")
+    endif()
+endforeach()
+if(NOT output MATCHES "${count} files processed on [0-9]+ threads, 0 failed")
+    message(FATAL_ERROR "Summary missing or reports failures")
+endif()
+
+foreach(i RANGE ${last})
+    list(GET outputs ${i} output_file)
+    list(GET GOLD_OUTPUTS ${i} gold)
+    list(GET SIZES ${i} size)
+    file(SIZE "${output_file}" output_size)
+    if(NOT output_size EQUAL size)
+        message(FATAL_ERROR "Output file ${output_file} is ${output_size} bytes, expected ${size}")
+    endif()
+    file(READ "${output_file}" output_data HEX)
+    file(READ "${gold}" gold_data LIMIT ${size} HEX)
+    if(NOT output_data STREQUAL gold_data)
+        message(FATAL_ERROR "Output file ${output_file} does not match gold file ${gold}")
+    endif()
+endforeach()
@@ -0,0 +1,51 @@
+message(STATUS "TGAINDEX=${TGAINDEX}")
+message(STATUS "TGAPACK=${TGAPACK}")
+message(STATUS "IMAGE=${IMAGE}")
+message(STATUS "OUTPUT=${OUTPUT}")
+message(STATUS "SIZE=${SIZE}")
+message(STATUS "GOLD_OUTPUT=${GOLD_OUTPUT}")
+message(STATUS "GOLD_SIZE=${GOLD_SIZE}")
+
+# tgaindex writes its index beside the image, so work on a copy of it.
+get_filename_component(OUTPUT_DIR "${OUTPUT}" DIRECTORY)
+file(MAKE_DIRECTORY "${OUTPUT_DIR}")
+configure_file("${IMAGE}" "${OUTPUT}" COPYONLY)
+file(REMOVE "${OUTPUT}.idx")
+
+execute_process(COMMAND "${TGAINDEX}" "${OUTPUT}"
+    RESULT_VARIABLE result)
+if(result)
+    message(FATAL_ERROR "Failed to execute tgaindex on ${OUTPUT}")
+endif()
+
+# The index is a fixed size header followed by one offset per row.
+file(SIZE "${OUTPUT}.idx" index_size)
+if(NOT index_size EQUAL SIZE)
+    message(FATAL_ERROR "Index file ${OUTPUT}.idx is ${index_size} bytes, expected ${SIZE}")
+endif()
+
+execute_process(COMMAND "${TGAINDEX}" -check "${OUTPUT}"
+    OUTPUT_VARIABLE output
+    RESULT_VARIABLE result)
+if(result OR NOT output MATCHES "index up to date")
+    message(FATAL_ERROR "Index file ${OUTPUT}.idx was not accepted:\n${output}")
+endif()
+
+# Uncompressing the image on several threads starts each band from the
+# index, and must give the same image data as the gold file.
+if(GOLD_OUTPUT)
+    execute_process(COMMAND "${TGAPACK}" -unpack -threads 4 "${OUTPUT}"
+        RESULT_VARIABLE result)
+    if(result)
+        message(FATAL_ERROR "Failed to execute tgapack on ${OUTPUT}")
+    endif()
+    file(SIZE "${OUTPUT}" output_size)
+    if(NOT output_size EQUAL GOLD_SIZE)
+        message(FATAL_ERROR "Output file ${OUTPUT} is ${output_size} bytes, expected ${GOLD_SIZE}")
+    endif()
+    file(READ "${OUTPUT}" output_data HEX)
+    file(READ "${GOLD_OUTPUT}" gold_data LIMIT ${GOLD_SIZE} HEX)
+    if(NOT output_data STREQUAL gold_data)
+        message(FATAL_ERROR "Output file ${OUTPUT} does not match gold file ${GOLD_OUTPUT}")
+    endif()
+endif()
@@ -0,0 +1,41 @@
+message(STATUS "TGAMIP=${TGAMIP}")
+message(STATUS "OPTIONS=${OPTIONS}")
+message(STATUS "IMAGE=${IMAGE}")
+message(STATUS "OUTPUT=${OUTPUT}")
+message(STATUS "GOLD_OUTPUT=${GOLD_OUTPUT}")
+message(STATUS "LEVELS=${LEVELS}")
+
+# tgamip writes its levels beside the image, so work on a copy of it.
+get_filename_component(OUTPUT_DIR "${OUTPUT}" DIRECTORY)
+get_filename_component(OUTPUT_NAME "${OUTPUT}" NAME_WE)
+get_filename_component(GOLD_DIR "${GOLD_OUTPUT}" DIRECTORY)
+get_filename_component(GOLD_NAME "${GOLD_OUTPUT}" NAME_WE)
+file(REMOVE_RECURSE "${OUTPUT_DIR}")
+file(MAKE_DIRECTORY "${OUTPUT_DIR}")
+configure_file("${IMAGE}" "${OUTPUT}" COPYONLY)
+
+execute_process(COMMAND "${TGAMIP}" ${OPTIONS} "${OUTPUT}"
+    RESULT_VARIABLE result)
+if(result)
+    message(FATAL_ERROR "Failed to execute tgamip on ${OUTPUT}")
+endif()
+
+# Level n of the pyramid is written at 1/2^n scale, and must match the
+# gold file of the same name beside the image.
+set(scale 2)
+foreach(level RANGE 1 ${LEVELS})
+    set(level_file "${OUTPUT_DIR}/${OUTPUT_NAME}_${scale}.tga")
+    set(gold_file "${GOLD_DIR}/${GOLD_NAME}_${scale}.tga")
+    if(NOT EXISTS "${level_file}")
+        message(FATAL_ERROR "Level file ${level_file} was not written")
+    endif()
+    execute_process(COMMAND "${CMAKE_COMMAND}" -E compare_files "${level_file}" "${gold_file}"
+        RESULT_VARIABLE result)
+    if(result)
+        message(FATAL_ERROR "Level file ${level_file} does not match gold file ${gold_file}")
+    endif()
+    math(EXPR scale "${scale} * 2")
+endforeach()
+if(EXISTS "${OUTPUT_DIR}/${OUTPUT_NAME}_${scale}.tga")
+    message(FATAL_ERROR "More than ${LEVELS} levels were written for ${OUTPUT}")
+endif()
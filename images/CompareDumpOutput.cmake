@@ -1,6 +1,7 @@
 message(STATUS "CMAKE_COMMAND=${CMAKE_COMMAND}")
 message(STATUS "WORKING_DIR=${WORKING_DIR}")
 message(STATUS "TGADUMP=${TGADUMP}")
+message(STATUS "OPTIONS=${OPTIONS}")
 message(STATUS "IMAGE=${IMAGE}")
 message(STATUS "OUTPUT=${OUTPUT}")
 message(STATUS "GOLD_OUTPUT=${GOLD_OUTPUT}")
@@ -9,7 +10,7 @@ function(cat file)
     execute_process(COMMAND "${CMAKE_COMMAND}" "-E" "cat" "${file}")
 endfunction()
 
-execute_process(COMMAND "${TGADUMP}" "${IMAGE}" OUTPUT_FILE "${OUTPUT}"
+execute_process(COMMAND "${TGADUMP}" ${OPTIONS} ${IMAGE} OUTPUT_FILE "${OUTPUT}"
     WORKING_DIRECTORY "${WORKING_DIR}"
     RESULT_VARIABLE result)
 if(result)
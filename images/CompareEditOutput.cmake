@@ -0,0 +1,28 @@
+message(STATUS "TGAEDIT=${TGAEDIT}")
+message(STATUS "OPTIONS=${OPTIONS}")
+message(STATUS "IMAGE=${IMAGE}")
+message(STATUS "OUTPUT=${OUTPUT}")
+message(STATUS "GOLD_OUTPUT=${GOLD_OUTPUT}")
+message(STATUS "MESSAGE=${MESSAGE}")
+
+# tgaedit rewrites its input in place, so work on a copy of the image.
+get_filename_component(OUTPUT_DIR "${OUTPUT}" DIRECTORY)
+file(MAKE_DIRECTORY "${OUTPUT_DIR}")
+configure_file("${IMAGE}" "${OUTPUT}" COPYONLY)
+
+execute_process(COMMAND "${TGAEDIT}" -noprompt ${OPTIONS} "${OUTPUT}"
+    OUTPUT_VARIABLE output
+    RESULT_VARIABLE result)
+message(STATUS "${output}")
+if(result OR output MATCHES "Error")
+    message(FATAL_ERROR "Failed to execute tgaedit on ${OUTPUT}")
+endif()
+if(MESSAGE AND NOT output MATCHES "${MESSAGE}")
+    message(FATAL_ERROR "tgaedit did not report \"${MESSAGE}\"")
+endif()
+
+file(READ "${OUTPUT}" output_data HEX)
+file(READ "${GOLD_OUTPUT}" gold_data HEX)
+if(NOT output_data STREQUAL gold_data)
+    message(FATAL_ERROR "Output file ${OUTPUT} does not match gold file ${GOLD_OUTPUT}")
+endif()
@@ -0,0 +1,41 @@
+message(STATUS "TGAPACK=${TGAPACK}")
+message(STATUS "OPTIONS=${OPTIONS}")
+message(STATUS "STREAM=${STREAM}")
+message(STATUS "IMAGE=${IMAGE}")
+message(STATUS "OUTPUT=${OUTPUT}")
+message(STATUS "GOLD_OUTPUT=${GOLD_OUTPUT}")
+message(STATUS "SIZE=${SIZE}")
+
+get_filename_component(OUTPUT_DIR "${OUTPUT}" DIRECTORY)
+file(MAKE_DIRECTORY "${OUTPUT_DIR}")
+if(STREAM)
+    # In stream mode the image is piped through tgapack.
+    execute_process(COMMAND "${CMAKE_COMMAND}" -E cat "${IMAGE}"
+        COMMAND "${TGAPACK}" ${OPTIONS} -i - -o -
+        OUTPUT_FILE "${OUTPUT}"
+        RESULTS_VARIABLE results)
+    if(NOT results STREQUAL "0;0")
+        message(FATAL_ERROR "Failed to pipe ${IMAGE} through tgapack")
+    endif()
+else()
+    # tgapack rewrites its input in place, so work on a copy of the image.
+    configure_file("${IMAGE}" "${OUTPUT}" COPYONLY)
+
+    execute_process(COMMAND "${TGAPACK}" ${OPTIONS} "${OUTPUT}"
+        RESULT_VARIABLE result)
+    if(result)
+        message(FATAL_ERROR "Failed to execute tgapack on ${OUTPUT}")
+    endif()
+endif()
+
+# The output is an original TGA file, which matches the leading
+# header, color map and image data of the extended gold file.
+file(SIZE "${OUTPUT}" output_size)
+if(NOT output_size EQUAL SIZE)
+    message(FATAL_ERROR "Output file ${OUTPUT} is ${output_size} bytes, expected ${SIZE}")
+endif()
+file(READ "${OUTPUT}" output_data HEX)
+file(READ "${GOLD_OUTPUT}" gold_data LIMIT ${SIZE} HEX)
+if(NOT output_data STREQUAL gold_data)
+    message(FATAL_ERROR "Output file ${OUTPUT} does not match gold file ${GOLD_OUTPUT}")
+endif()
@@ -0,0 +1,678 @@
+/*
+** TGATEST checks the library entry points that no tool reaches on its
+** own, by decoding a Truevision TGA(tm) File in different ways and
+** comparing the results.  Each test names the check to run, followed by
+** its arguments, and the program exits with status 0 if the check
+** passes.
+**
+** Usage: tgatest test file ...
+**
+**      copy file copy  copy pieces of the file, from different offsets,
+**                      after data already written to a new file, which
+**                      must then hold the same bytes as the pieces
+**      map file        decode the image from a memory mapping and from a
+**                      copy of the file in memory, and compare both with
+**                      a decode from the file stream
+**      index file copy index a copy of a run length encoded image through
+**                      an index cache and a sidecar index, and decode it
+**                      in parallel and by region with the indexed rows
+**      region file     decode windows of the image in each row and pixel
+**                      order, and compare them with the same rows and
+**                      columns of the whole image decoded in that order
+**      wrap file gold  decode an image whose run length packets wrap
+**                      across scan lines, which must be refused unless
+**                      wrapping is allowed, whatever the layout asked
+**                      for, and must then match the gold image
+*/
+
+#include <config/file_io.h>
+#include <config/string_case_compare.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tga.h>
+
+extern int              main( int, char ** );
+extern int              CheckCopy( char *, char * );
+extern int              CheckIndex( char *, char * );
+extern int              CheckIndexedDecode( TGADecoder *, unsigned char *, long );
+extern int              CheckMap( char * );
+extern int              CheckRegion( char * );
+extern int              CheckWrap( char *, char * );
+extern unsigned char    *DecodeFile( char *, long * );
+extern int              FlipRows( TGAFile *, int );
+extern unsigned char    *LoadFile( char *, long * );
+extern int              SaveFile( char *, unsigned char *, long );
+
+
+int main( int argc, char **argv )
+{
+        int                     status;
+
+        if ( argc < 3 )
+        {
+                puts( "Usage: tgatest test file ..." );
+                exit( 1 );
+        }
+        if ( string_case_compare( argv[1], "copy" ) == 0 && argc > 3 )
+                status = CheckCopy( argv[2], argv[3] );
+        else if ( string_case_compare( argv[1], "index" ) == 0 && argc > 3 )
+                status = CheckIndex( argv[2], argv[3] );
+        else if ( string_case_compare( argv[1], "map" ) == 0 ) status = CheckMap( argv[2] );
+        else if ( string_case_compare( argv[1], "region" ) == 0 ) status = CheckRegion( argv[2] );
+        else if ( string_case_compare( argv[1], "wrap" ) == 0 && argc > 3 )
+                status = CheckWrap( argv[2], argv[3] );
+        else
+        {
+                printf( "Unknown test %s\n", argv[1] );
+                status = -1;
+        }
+        if ( status < 0 ) printf( "%s: FAILED\n", argv[1] );
+        else printf( "%s: passed\n", argv[1] );
+        return( status < 0 ? 1 : 0 );
+}
+
+
+/*
+** Read the whole of a file into memory.
+*/
+unsigned char *LoadFile( char *fileName, long *sizep )
+{
+        FILE            *fp;
+        unsigned char   *data;
+        long            size;
+
+        if ( ( fp = fopen( fileName, "rb" ) ) == NULL )
+        {
+                printf( "Unable to open %s\n", fileName );
+                return( NULL );
+        }
+        data = NULL;
+        if ( fseek( fp, 0L, SEEK_END ) == 0 && ( size = ftell( fp ) ) > 0 &&
+                        fseek( fp, 0L, SEEK_SET ) == 0 &&
+                        ( data = malloc( size ) ) != NULL &&
+                        (long)fread( data, 1, size, fp ) != size )
+        {
+                free( data );
+                data = NULL;
+        }
+        if ( data == NULL ) printf( "Unable to read %s\n", fileName );
+        else *sizep = size;
+        fclose( fp );
+        return( data );
+}
+
+
+/*
+** Write a whole file from memory.
+*/
+int SaveFile( char *fileName, unsigned char *data, long size )
+{
+        FILE            *fp;
+        int                     status = 0;
+
+        if ( ( fp = fopen( fileName, "wb" ) ) == NULL ) status = -1;
+        else
+        {
+                if ( (long)fwrite( data, 1, size, fp ) != size ) status = -1;
+                if ( fclose( fp ) != 0 ) status = -1;
+        }
+        if ( status < 0 ) printf( "Unable to write %s\n", fileName );
+        return( status );
+}
+
+
+/*
+** Decode a whole image from its file stream, in stored order.  Returns
+** a buffer to be freed by the caller, and the size of the image in
+** bytes.
+*/
+unsigned char *DecodeFile( char *fileName, long *sizep )
+{
+        TGAFile         f;
+        TGADecoder      d;
+        FILE            *fp;
+        unsigned char   *image;
+
+        if ( ( fp = fopen( fileName, "rb" ) ) == NULL )
+        {
+                printf( "Unable to open %s\n", fileName );
+                return( NULL );
+        }
+        image = NULL;
+        if ( ReadTGAFile( fp, &f ) < 0 )
+        {
+                printf( "Error reading %s\n", fileName );
+                fclose( fp );
+                return( NULL );
+        }
+        if ( InitTGADecoder( &d, fp, &f ) == 0 )
+        {
+                *sizep = d.rowBytes * f.imageHeight;
+                if ( ( image = malloc( *sizep ) ) != NULL &&
+                                DecodeTGAImage( &d, &image, 0, 0 ) < 0 )
+                {
+                        free( image );
+                        image = NULL;
+                }
+                FreeTGADecoder( &d );
+        }
+        if ( image == NULL ) printf( "Error decoding %s\n", fileName );
+        FreeTGAFile( &f );
+        fclose( fp );
+        return( image );
+}
+
+
+/*
+** Returns non-zero if the decoder flags reverse the stored row order,
+** which is bottom up unless bit 5 of the image descriptor is set.
+*/
+int FlipRows( TGAFile *sp, int flags )
+{
+        if ( sp->imageDesc & 0x20 ) return( ( flags & TGA_DECODE_BOTTOM_UP ) != 0 );
+        return( ( flags & TGA_DECODE_TOP_DOWN ) != 0 );
+}
+
+
+/*
+** Check that a decoder given the row offsets of its image decodes the
+** image in parallel, and a window of it, the same as the stream decode.
+*/
+int CheckIndexedDecode( TGADecoder *dp, unsigned char *gold, long size )
+{
+        unsigned char   *image;
+        unsigned char   *window;
+        long            rowBytes = dp->rowBytes;
+        int                     w = dp->sp->imageWidth;
+        int                     h = dp->sp->imageHeight;
+        int                     status = 0;
+        int                     y;
+
+        window = malloc( rowBytes * h );
+        if ( window == NULL ) return( -1 );
+        if ( DecodeTGARegion( dp, w / 4, h / 3, w / 2, h / 2, window, rowBytes, 0 ) < 0 )
+                status = -1;
+        for ( y = 0; status == 0 && y < h / 2; ++y )
+        {
+                if ( memcmp( window + rowBytes * y,
+                                gold + rowBytes * ( h / 3 + y ) + ( w / 4 ) * ( rowBytes / w ),
+                                ( w / 2 ) * ( rowBytes / w ) ) != 0 )
+                        status = -1;
+        }
+        free( window );
+        image = NULL;
+        if ( status == 0 && ( DecodeTGAImageParallel( dp, &image, 0, 0, 4 ) < 0 ||
+                        memcmp( image, gold, size ) != 0 ) )
+                status = -1;
+        return( status );
+}
+
+
+/*
+** Copy pieces of a file with file_copy, each following whatever was
+** written to the output before it, including a piece that runs past the
+** end of the file and must be cut short.  The position of the input must
+** not move, and the output must be left just after each piece, so that
+** writes through the stream carry on from there.
+*/
+int CheckCopy( char *fileName, char *copyName )
+{
+        static char     marker[] = "file_copy";
+        FILE            *ifp;
+        FILE            *ofp;
+        unsigned char   *data;
+        unsigned char   *gold;
+        unsigned char   *copy;
+        long            pieces[5][2];
+        long            fileSize;
+        long            copySize;
+        long            goldSize;
+        long            count;
+        long            expect;
+        int                     status = 0;
+        int                     i;
+
+        if ( ( data = LoadFile( fileName, &fileSize ) ) == NULL ) return( -1 );
+        pieces[0][0] = 0L;                      pieces[0][1] = fileSize;
+        pieces[1][0] = 1L;                      pieces[1][1] = fileSize - 1;
+        pieces[2][0] = fileSize / 3;            pieces[2][1] = fileSize / 2;
+        pieces[3][0] = fileSize - 5;            pieces[3][1] = 0L;
+        pieces[4][0] = fileSize - 10;           pieces[4][1] = 20L;
+        gold = malloc( 3 * fileSize + 6 * sizeof( marker ) );
+        ifp = fopen( fileName, "rb" );
+        ofp = fopen( copyName, "wb+" );
+        if ( gold == NULL || ifp == NULL || ofp == NULL || fseek( ifp, 7L, SEEK_SET ) != 0 )
+        {
+                printf( "Unable to copy %s to %s\n", fileName, copyName );
+                if ( ifp != NULL ) fclose( ifp );
+                if ( ofp != NULL ) fclose( ofp );
+                free( gold );
+                free( data );
+                return( -1 );
+        }
+        goldSize = 0L;
+        for ( i = 0; i < 5 && status == 0; ++i )
+        {
+                if ( fwrite( marker, 1, sizeof( marker ), ofp ) != sizeof( marker ) )
+                {
+                        status = -1;
+                        break;
+                }
+                memcpy( gold + goldSize, marker, sizeof( marker ) );
+                goldSize += sizeof( marker );
+                expect = pieces[i][1];
+                if ( pieces[i][0] + expect > fileSize ) expect = fileSize - pieces[i][0];
+                count = file_copy( ifp, pieces[i][0], ofp, pieces[i][1] );
+                if ( count != expect || ftell( ofp ) != goldSize + expect || ftell( ifp ) != 7L )
+                {
+                        printf( "%s: copy of %ld bytes from %ld gave %ld\n",
+                                        fileName, pieces[i][1], pieces[i][0], count );
+                        status = -1;
+                }
+                memcpy( gold + goldSize, data + pieces[i][0], expect );
+                goldSize += expect;
+        }
+        if ( status == 0 && fwrite( marker, 1, sizeof( marker ), ofp ) != sizeof( marker ) ) status = -1;
+        memcpy( gold + goldSize, marker, sizeof( marker ) );
+        goldSize += sizeof( marker );
+        fclose( ifp );
+        if ( fclose( ofp ) != 0 ) status = -1;
+        if ( status == 0 )
+        {
+                if ( ( copy = LoadFile( copyName, &copySize ) ) == NULL ) status = -1;
+                else if ( copySize != goldSize || memcmp( copy, gold, goldSize ) != 0 )
+                {
+                        printf( "%s: copied data does not match\n", copyName );
+                        status = -1;
+                }
+                free( copy );
+        }
+        free( gold );
+        free( data );
+        return( status );
+}
+
+
+/*
+** Index a copy of an image, first through a cache of indexes, which
+** must hold the offsets for a second decoder without the image being
+** read again, and then through a sidecar index file.
+*/
+int CheckIndex( char *fileName, char *copyName )
+{
+        TGAIndexCache   *cache;
+        TGAFile         f;
+        TGAFile         sf;
+        TGAMap          map;
+        TGADecoder      d;
+        FILE            *fp;
+        UINT32          *offsets;
+        unsigned char   *data;
+        unsigned char   *gold;
+        char            *sidecar;
+        long            fileSize;
+        long            size;
+        int                     status = 0;
+
+        if ( ( data = LoadFile( fileName, &fileSize ) ) == NULL ) return( -1 );
+        sidecar = malloc( strlen( copyName ) + sizeof( TGA_INDEX_SUFFIX ) );
+        if ( sidecar == NULL || SaveFile( copyName, data, fileSize ) < 0 ||
+                        ( gold = DecodeFile( copyName, &size ) ) == NULL )
+        {
+                free( sidecar );
+                free( data );
+                return( -1 );
+        }
+        strcpy( sidecar, copyName );
+        strcat( sidecar, TGA_INDEX_SUFFIX );
+        remove( sidecar );
+        cache = CreateTGAIndexCache( 4 );
+        offsets = NULL;
+        if ( ( fp = fopen( copyName, "rb" ) ) == NULL || ReadTGAFile( fp, &f ) < 0 || cache == NULL )
+        {
+                printf( "Unable to read %s\n", copyName );
+                if ( fp != NULL ) fclose( fp );
+                FreeTGAIndexCache( cache );
+                free( gold );
+                free( sidecar );
+                free( data );
+                return( -1 );
+        }
+
+        /*
+        ** With no sidecar the image is indexed on the first load, and the
+        ** offsets kept in the cache.
+        */
+        if ( InitTGADecoder( &d, fp, &f ) < 0 || ReadTGAIndex( copyName, &d ) != TGA_INDEX_ERROR_OPEN ||
+                        LoadTGAIndex( cache, copyName, &d ) < 0 || d.rowOffsets == NULL ||
+                        ( offsets = malloc( f.imageHeight * sizeof( UINT32 ) ) ) == NULL ||
+                        CheckIndexedDecode( &d, gold, size ) < 0 )
+        {
+                printf( "%s: first indexed decode failed\n", copyName );
+                status = -1;
+        }
+        else memcpy( offsets, d.rowOffsets, f.imageHeight * sizeof( UINT32 ) );
+        FreeTGADecoder( &d );
+
+        /*
+        ** A second load must come from the cache, so it is made for a
+        ** decoder of a copy of the file whose image data is cleared, from
+        ** which different offsets, if any, would be found.
+        */
+        if ( status == 0 )
+        {
+                memset( data + GetTGADataOffset( &f ), 0, fileSize - GetTGADataOffset( &f ) );
+                map.data = data;
+                map.size = fileSize;
+                map.handle = NULL;
+                if ( ReadTGAMemory( data, fileSize, &sf ) < 0 )
+                        status = -1;
+                else
+                {
+                        if ( InitTGAMapDecoder( &d, &map, &sf ) < 0 ||
+                                        LoadTGAIndex( cache, copyName, &d ) < 0 ||
+                                        d.rowOffsets == NULL ||
+                                        memcmp( d.rowOffsets, offsets, f.imageHeight * sizeof( UINT32 ) ) != 0 )
+                                status = -1;
+                        FreeTGADecoder( &d );
+                        FreeTGAFile( &sf );
+                }
+                if ( status < 0 ) printf( "%s: index not found in cache\n", copyName );
+        }
+        if ( status == 0 && ( InitTGADecoder( &d, fp, &f ) < 0 ||
+                        LoadTGAIndex( cache, copyName, &d ) < 0 ||
+                        CheckIndexedDecode( &d, gold, size ) < 0 ) )
+        {
+                printf( "%s: cached indexed decode failed\n", copyName );
+                status = -1;
+        }
+        FreeTGADecoder( &d );
+
+        /*
+        ** A sidecar written from the index gives the same offsets.
+        */
+        if ( status == 0 && ( InitTGADecoder( &d, fp, &f ) < 0 ||
+                        WriteTGAIndex( copyName, &d ) < 0 ) )
+        {
+                printf( "%s: unable to write index\n", copyName );
+                status = -1;
+        }
+        FreeTGADecoder( &d );
+        if ( status == 0 && ( InitTGADecoder( &d, fp, &f ) < 0 ||
+                        ReadTGAIndex( copyName, &d ) < 0 || d.rowOffsets == NULL ||
+                        memcmp( d.rowOffsets, offsets, f.imageHeight * sizeof( UINT32 ) ) != 0 ||
+                        CheckIndexedDecode( &d, gold, size ) < 0 ) )
+        {
+                printf( "%s: sidecar indexed decode failed\n", copyName );
+                status = -1;
+        }
+        FreeTGADecoder( &d );
+        FreeTGAIndexCache( cache );
+        FreeTGAFile( &f );
+        fclose( fp );
+        free( offsets );
+        free( gold );
+        free( sidecar );
+        free( data );
+        return( status );
+}
+
+
+/*
+** Decode an image through a memory mapping and through a copy of the
+** file in memory.  Uncompressed images are also compared with the image
+** data of the mapping itself, which should be decoded without a copy.
+*/
+int CheckMap( char *fileName )
+{
+        TGAFile         f;
+        TGAMap          map;
+        TGADecoder      d;
+        unsigned char   *gold;
+        unsigned char   *data;
+        unsigned char   *image;
+        const unsigned char     *direct;
+        long            size;
+        long            fileSize;
+        int                     status = 0;
+
+        if ( ( gold = DecodeFile( fileName, &size ) ) == NULL ) return( -1 );
+
+        if ( MapTGAFile( fileName, &map, &f ) < 0 )
+        {
+                printf( "Unable to map %s\n", fileName );
+                free( gold );
+                return( -1 );
+        }
+        image = NULL;
+        if ( InitTGAMapDecoder( &d, &map, &f ) < 0 ||
+                        DecodeTGAImage( &d, &image, 0, 0 ) < 0 ||
+                        memcmp( image, gold, size ) != 0 )
+        {
+                printf( "%s: mapped decode differs\n", fileName );
+                status = -1;
+        }
+        FreeTGADecoder( &d );
+        direct = GetTGAMappedImage( &map, &f );
+        if ( ( f.imageType >= 1 && f.imageType <= 3 ) !=
+                        ( direct != NULL ) ||
+                        ( direct != NULL && memcmp( direct, gold, size ) != 0 ) )
+        {
+                printf( "%s: mapped image data differs\n", fileName );
+                status = -1;
+        }
+        FreeTGAFile( &f );
+        UnmapTGAFile( &map );
+
+        if ( ( data = LoadFile( fileName, &fileSize ) ) == NULL )
+        {
+                free( gold );
+                return( -1 );
+        }
+        image = NULL;
+        if ( ReadTGAMemory( data, fileSize, &f ) < 0 )
+        {
+                printf( "Error reading %s from memory\n", fileName );
+                status = -1;
+        }
+        else
+        {
+                map.data = data;
+                map.size = fileSize;
+                map.handle = NULL;
+                if ( InitTGAMapDecoder( &d, &map, &f ) < 0 ||
+                                DecodeTGAImage( &d, &image, 0, 0 ) < 0 ||
+                                memcmp( image, gold, size ) != 0 )
+                {
+                        printf( "%s: memory decode differs\n", fileName );
+                        status = -1;
+                }
+                FreeTGADecoder( &d );
+                FreeTGAFile( &f );
+        }
+        free( data );
+        free( gold );
+        return( status );
+}
+
+
+/*
+** Decode windows at the corners and in the middle of an image, and a
+** window of a single pixel, with and without padding between rows.
+** Each window must match the part of the whole image it covers, when
+** the image is decoded with the same flags.
+*/
+int CheckRegion( char *fileName )
+{
+        static const int        flags[] =
+        {
+                0,
+                TGA_DECODE_TOP_DOWN,
+                TGA_DECODE_BOTTOM_UP,
+                TGA_DECODE_LEFT_RIGHT,
+                TGA_DECODE_TOP_DOWN | TGA_DECODE_LEFT_RIGHT,
+                TGA_DECODE_BOTTOM_UP | TGA_DECODE_LEFT_RIGHT
+        };
+        TGAFile         f;
+        TGADecoder      d;
+        FILE            *fp;
+        unsigned char   *image;
+        unsigned char   *window;
+        long            stride;
+        int                     windows[6][4];
+        int                     status = 0;
+        int                     pad;
+        int                     bpp;
+        int                     i;
+        int                     k;
+        int                     y;
+        int                     x0, y0, w, h;
+
+        if ( ( fp = fopen( fileName, "rb" ) ) == NULL || ReadTGAFile( fp, &f ) < 0 )
+        {
+                printf( "Unable to read %s\n", fileName );
+                if ( fp != NULL ) fclose( fp );
+                return( -1 );
+        }
+        w = f.imageWidth;
+        h = f.imageHeight;
+        windows[0][0] = 0; windows[0][1] = 0; windows[0][2] = w; windows[0][3] = h;
+        windows[1][0] = 0; windows[1][1] = 0; windows[1][2] = w / 3; windows[1][3] = h / 4;
+        windows[2][0] = w / 5; windows[2][1] = h / 3; windows[2][2] = w / 2; windows[2][3] = h / 2;
+        windows[3][0] = w - w / 4; windows[3][1] = h - h / 5; windows[3][2] = w / 4; windows[3][3] = h / 5;
+        windows[4][0] = w - 1; windows[4][1] = 0; windows[4][2] = 1; windows[4][3] = 1;
+        windows[5][0] = 1; windows[5][1] = h / 2; windows[5][2] = w - 2; windows[5][3] = 1;
+
+        for ( i = 0; i < (int)( sizeof( flags ) / sizeof( flags[0] ) ) && status == 0; ++i )
+        {
+                if ( InitTGADecoder( &d, fp, &f ) < 0 )
+                {
+                        status = -1;
+                        break;
+                }
+                image = NULL;
+                if ( DecodeTGAImage( &d, &image, 0, flags[i] ) < 0 )
+                {
+                        printf( "%s: unable to decode image\n", fileName );
+                        FreeTGADecoder( &d );
+                        status = -1;
+                        break;
+                }
+                bpp = d.pixelBytes;
+                for ( k = 0; k < 6 && status == 0; ++k )
+                {
+                        for ( pad = 0; pad <= 5 && status == 0; pad += 5 )
+                        {
+                                x0 = windows[k][0];
+                                y0 = windows[k][1];
+                                stride = (long)windows[k][2] * bpp + pad;
+                                window = malloc( stride * windows[k][3] );
+                                if ( window == NULL ) status = -1;
+                                else if ( DecodeTGARegion( &d, x0, y0, windows[k][2], windows[k][3],
+                                                window, stride, flags[i] ) < 0 )
+                                {
+                                        printf( "%s: unable to decode window %d\n", fileName, k );
+                                        status = -1;
+                                }
+                                for ( y = 0; status == 0 && y < windows[k][3]; ++y )
+                                {
+                                        if ( memcmp( window + stride * y,
+                                                        image + d.rowBytes * ( y0 + y ) + (long)x0 * bpp,
+                                                        (size_t)windows[k][2] * bpp ) != 0 )
+                                        {
+                                                printf( "%s: window %d differs with flags %d\n",
+                                                                fileName, k, flags[i] );
+                                                status = -1;
+                                        }
+                                }
+                                free( window );
+                        }
+                }
+                FreeTGADecoder( &d );
+        }
+        FreeTGAFile( &f );
+        fclose( fp );
+        return( status );
+}
+
+
+/*
+** Decode an image with wrapping packets into a contiguous buffer in
+** stored order, into rows flipped top to bottom, and into rows with
+** padding between them.  The first takes a faster path through the
+** decoder than the others, but all must give the same result.
+*/
+int CheckWrap( char *fileName, char *goldName )
+{
+        static const struct
+        {
+                int             flags;
+                int             pad;
+        }               layouts[] =
+        {
+                { 0, 0 },
+                { TGA_DECODE_TOP_DOWN, 0 },
+                { TGA_DECODE_BOTTOM_UP, 0 },
+                { 0, 4 }
+        };
+        TGAFile         f;
+        TGADecoder      d;
+        FILE            *fp;
+        unsigned char   *gold;
+        unsigned char   *image;
+        unsigned char   *p;
+        long            size;
+        long            stride;
+        int                     wrap;
+        int                     status = 0;
+        int                     i;
+        int                     r;
+        int                     y;
+
+        if ( ( gold = DecodeFile( goldName, &size ) ) == NULL ) return( -1 );
+        if ( ( fp = fopen( fileName, "rb" ) ) == NULL || ReadTGAFile( fp, &f ) < 0 )
+        {
+                printf( "Unable to read %s\n", fileName );
+                if ( fp != NULL ) fclose( fp );
+                free( gold );
+                return( -1 );
+        }
+        for ( wrap = 0; wrap < 2; ++wrap )
+        {
+                for ( i = 0; i < (int)( sizeof( layouts ) / sizeof( layouts[0] ) ); ++i )
+                {
+                        if ( fseek( fp, 0L, SEEK_SET ) != 0 || InitTGADecoder( &d, fp, &f ) < 0 )
+                        {
+                                status = -1;
+                                break;
+                        }
+                        d.wrapPackets = wrap;
+                        stride = d.rowBytes + layouts[i].pad;
+                        image = NULL;
+                        r = DecodeTGAImage( &d, &image, stride, layouts[i].flags );
+                        if ( !wrap && r != TGA_DECODE_ERROR_BAD_PACKET )
+                        {
+                                printf( "%s: layout %d accepted wrapping packets\n", fileName, i );
+                                status = -1;
+                        }
+                        for ( y = 0; wrap && r == 0 && y < (int)f.imageHeight; ++y )
+                        {
+                                p = image + stride * ( FlipRows( &f, layouts[i].flags ) ?
+                                                f.imageHeight - 1 - y : y );
+                                if ( memcmp( p, gold + d.rowBytes * y, d.rowBytes ) != 0 ) r = -1;
+                        }
+                        if ( wrap && r != 0 )
+                        {
+                                printf( "%s: layout %d differs from %s\n", fileName, i, goldName );
+                                status = -1;
+                        }
+                        FreeTGADecoder( &d );
+                }
+        }
+        FreeTGAFile( &f );
+        fclose( fp );
+        free( gold );
+        return( status );
+}
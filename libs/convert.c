@@ -0,0 +1,102 @@
+#include <stddef.h>
+#include <tga.h>
+
+#include "kernels.h"
+
+const TGASwizzle TGASwizzleStripAlpha = { 4, 3, { 0, 1, 2, -1 }, 0 };
+const TGASwizzle TGASwizzleAddAlpha = { 3, 4, { 0, 1, 2, -1 }, 255 };
+const TGASwizzle TGASwizzleSwapRB32 = { 4, 4, { 2, 1, 0, 3 }, 0 };
+const TGASwizzle TGASwizzleSwapRB24 = { 3, 3, { 2, 1, 0, -1 }, 0 };
+
+/*
+** Rearrange the channels of count pixels from s into d.  The pixels may
+** be converted in place when the output pixels are no larger than the
+** input pixels; otherwise the buffers must not overlap.
+*/
+int SwizzleTGAPixels(unsigned char *d, const unsigned char *s, long count, const TGASwizzle *sw)
+{
+    int c;
+
+    if (d == NULL || s == NULL || sw == NULL)
+    {
+        return TGA_CONVERT_ERROR_NULL_ARGUMENT;
+    }
+    if (sw->srcBpp < 1 || sw->srcBpp > 4 || sw->dstBpp < 1 || sw->dstBpp > 4)
+    {
+        return TGA_CONVERT_ERROR_BAD_SWIZZLE;
+    }
+    for (c = 0; c < sw->dstBpp; ++c)
+    {
+        if (sw->map[c] >= sw->srcBpp)
+        {
+            return TGA_CONVERT_ERROR_BAD_SWIZZLE;
+        }
+    }
+    if (count > 0)
+    {
+        GetTGAKernels()->swizzle(d, s, count, sw);
+    }
+    return 0;
+}
+
+/*
+** Threshold of each position of a 4 by 4 ordered dither, scaled to the
+** 8 levels lost when a channel is cut from 8 bits to 5.
+*/
+static const unsigned char ditherMatrix[4][4] =
+{
+    { 0, 4, 1, 5 },
+    { 6, 2, 7, 3 },
+    { 1, 5, 0, 4 },
+    { 7, 3, 6, 2 },
+};
+
+/*
+** Widen count 16 bit pixels from s to pixels of dstBpp bytes, 3 or 4,
+** in d, which must not overlap s.  Each 5 bit channel becomes 8 bits,
+** with 31 giving 255, and alpha is 255 when the attribute bit is set
+** or 0 when it is clear.  With TGA_CONVERT_NO_ALPHA the attribute bit
+** is ignored and every pixel is opaque.
+*/
+int WidenTGAPixels(unsigned char *d, const unsigned char *s, long count, int dstBpp, int flags)
+{
+    if (d == NULL || s == NULL)
+    {
+        return TGA_CONVERT_ERROR_NULL_ARGUMENT;
+    }
+    if (dstBpp != 3 && dstBpp != 4)
+    {
+        return TGA_CONVERT_ERROR_BAD_DEPTH;
+    }
+    if (count > 0)
+    {
+        GetTGAKernels()->widen(d, s, count, dstBpp, flags);
+    }
+    return 0;
+}
+
+/*
+** Narrow count pixels of srcBpp bytes, 3 or 4, from s to 16 bit pixels
+** in d, which may be s.  The attribute bit is set for alpha of 128 and
+** above, and for every 3 byte pixel, unless TGA_CONVERT_NO_ALPHA leaves
+** it clear.  Channels are cut to 5 bits, or with TGA_CONVERT_DITHER are
+** first offset by an ordered dither, for which row is the row of the
+** image holding the pixels and the first pixel is at its left edge.
+*/
+int NarrowTGAPixels(unsigned char *d, const unsigned char *s, long count, int srcBpp, int flags, long row)
+{
+    if (d == NULL || s == NULL)
+    {
+        return TGA_CONVERT_ERROR_NULL_ARGUMENT;
+    }
+    if (srcBpp != 3 && srcBpp != 4)
+    {
+        return TGA_CONVERT_ERROR_BAD_DEPTH;
+    }
+    if (count > 0)
+    {
+        GetTGAKernels()->narrow(d, s, count, srcBpp, flags,
+                                (flags & TGA_CONVERT_DITHER) ? ditherMatrix[row & 3] : NULL);
+    }
+    return 0;
+}
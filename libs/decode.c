@@ -0,0 +1,1495 @@
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tga.h>
+
+#include <config/file_io.h>
+
+#include "kernels.h"
+#include "pool.h"
+
+#define DECODE_BUFSIZ 65536      /* size of decoder input buffer */
+#define MAXPACKET (1 + 128 * 4)  /* size of largest possible RLE packet */
+
+/*
+** Return the offset from the start of the file to the image data field,
+** which follows the header, the image ID and the color map data.
+*/
+long GetTGADataOffset(TGAFile *sp)
+{
+    long offset = 18; /* size of header in bytes */
+
+    offset += sp->idLength;
+    offset += ((sp->mapWidth + 7) >> 3) * (long) sp->mapLength;
+    return offset;
+}
+
+/*
+** Return the size of a stored row of uncompressed image data, which
+** differs from rowBytes when color map indices are being expanded.
+*/
+static long StoredRowBytes(TGADecoder *dp)
+{
+    return dp->bytesPerPixel * (long) dp->sp->imageWidth;
+}
+
+/*
+** Read up to n bytes of image data from the file into p, either at the
+** stream position or at the decoder's own offset into the file.  Either
+** way inOffset is kept as the offset of the data following inEnd.
+*/
+static long ReadDecoder(TGADecoder *dp, unsigned char *p, long n)
+{
+    long got;
+
+    if (dp->positioned)
+        got = file_read_at(dp->fp, p, n, dp->inOffset);
+    else
+        got = (long) fread(p, 1, n, dp->fp);
+    if (got < 0)
+        return 0;
+    dp->inOffset += got;
+    return got;
+}
+
+/*
+** Return the file offset of the next unread byte of image data.
+*/
+static long TellDecoder(TGADecoder *dp)
+{
+    return dp->inOffset - (long) (dp->inEnd - dp->inPtr);
+}
+
+/*
+** Move a decoder to an offset in the file, reusing the buffered data
+** when the offset falls within it.
+*/
+static int SeekDecoder(TGADecoder *dp, long offset)
+{
+    unsigned char *start = dp->fp == NULL ? dp->inEnd - dp->inOffset : dp->inBuf;
+    long back = dp->inOffset - offset;
+
+    if (back >= 0 && back <= (long) (dp->inEnd - start))
+    {
+        dp->inPtr = dp->inEnd - back;
+        return 0;
+    }
+    if (dp->fp == NULL || (!dp->positioned && fseek(dp->fp, offset, SEEK_SET) != 0))
+    {
+        return TGA_DECODE_ERROR_SEEK;
+    }
+    dp->inPtr = dp->inEnd = dp->inBuf;
+    dp->inOffset = offset;
+    return 0;
+}
+
+/*
+** Make at least n bytes of image data available in the input buffer.
+** Returns the number of bytes actually available, which is only less
+** than n when the end of the file has been reached.
+*/
+static long FillDecoder(TGADecoder *dp, long n)
+{
+    long avail = (long) (dp->inEnd - dp->inPtr);
+
+    /*
+    ** A decoder reading from memory already has all the data.
+    */
+    if (avail < n && dp->fp != NULL)
+    {
+        memmove(dp->inBuf, dp->inPtr, avail);
+        dp->inPtr = dp->inBuf;
+        dp->inEnd = dp->inBuf + avail;
+        dp->inEnd += ReadDecoder(dp, dp->inEnd, dp->inSize - avail);
+        avail = (long) (dp->inEnd - dp->inPtr);
+    }
+    return avail;
+}
+
+/*
+** Copy n bytes of uncompressed image data to p.
+*/
+static int DecodeRawBytes(TGADecoder *dp, unsigned char *p, long n)
+{
+    long avail = (long) (dp->inEnd - dp->inPtr);
+
+    /*
+    ** Drain whatever is already buffered, then read the rest of the
+    ** data straight into the caller's buffer.
+    */
+    if (avail > n)
+        avail = n;
+    memcpy(p, dp->inPtr, avail);
+    dp->inPtr += avail;
+    p += avail;
+    n -= avail;
+    if (n > 0)
+    {
+        if (dp->fp == NULL)
+            return TGA_DECODE_ERROR_READ;
+        dp->inPtr = dp->inEnd = dp->inBuf;
+        if (ReadDecoder(dp, p, n) != n)
+            return TGA_DECODE_ERROR_READ;
+    }
+    return 0;
+}
+
+/*
+** Return non-zero when stored pixels are not decoded as they are.
+*/
+static int Converting(TGADecoder *dp)
+{
+    return dp->pixelBytes != dp->bytesPerPixel || dp->correct != NULL;
+}
+
+/*
+** Convert count stored pixels at s to decoded pixels at d, expanding
+** color map indices or widening 16 bit pixels, and correcting colors.
+** Corrections of color mapped pixels are already part of the expanded
+** color map.
+*/
+static void ConvertPixels(TGADecoder *dp, unsigned char *d, const unsigned char *s, long count)
+{
+    if (dp->colors != NULL)
+    {
+        dp->kernels->expand(d, s, count, dp->bytesPerPixel, dp->colors, dp->pixelBytes);
+    }
+    else if (dp->pixelBytes != dp->bytesPerPixel)
+    {
+        dp->kernels->widen(d, s, count, dp->pixelBytes, dp->convertFlags);
+        if (dp->correct != NULL)
+            dp->kernels->lookup(d, d, count, dp->pixelBytes, dp->correct);
+    }
+    else
+    {
+        dp->kernels->lookup(d, s, count, dp->pixelBytes, dp->correct);
+    }
+}
+
+/*
+** Decode n pixels of uncompressed image data to p.  Pixels that are
+** being converted are converted straight from the input buffer.
+*/
+static int DecodeRawPixels(TGADecoder *dp, unsigned char *p, long n)
+{
+    int bpp = dp->bytesPerPixel;
+    long avail;
+    long count;
+
+    if (!Converting(dp))
+        return DecodeRawBytes(dp, p, n * bpp);
+    while (n > 0)
+    {
+        avail = (long) (dp->inEnd - dp->inPtr);
+        if (avail < bpp)
+            avail = FillDecoder(dp, bpp);
+        count = avail / bpp < n ? avail / bpp : n;
+        if (count < 1)
+            return TGA_DECODE_ERROR_READ;
+        ConvertPixels(dp, p, dp->inPtr, count);
+        dp->inPtr += count * bpp;
+        p += count * dp->pixelBytes;
+        n -= count;
+    }
+    return 0;
+}
+
+/*
+** Store the pixel of a run packet, converted once for the whole run.
+*/
+static void RunPixel(TGADecoder *dp, unsigned char *pixel, const unsigned char *q)
+{
+    if (Converting(dp))
+        ConvertPixels(dp, pixel, q, 1);
+    else
+        memcpy(pixel, q, dp->bytesPerPixel);
+}
+
+/*
+** Expand n pixels of run length encoded image data to p.  When packets
+** may wrap, the part of a packet beyond the end of the row is carried
+** over to the next call.
+*/
+static int DecodeRLEPixels(TGADecoder *dp, unsigned char *p, long n)
+{
+    int bpp = dp->bytesPerPixel;
+    int pb = dp->pixelBytes;
+    long count;
+    long avail;
+    unsigned char *q;
+    int status;
+
+    if (dp->carry > 0)
+    {
+        count = dp->carry < n ? dp->carry : n;
+        if (dp->carryRun)
+        {
+            dp->kernels->fill(p, dp->carryPixel, pb, count);
+        }
+        else
+        {
+            status = DecodeRawPixels(dp, p, count);
+            if (status < 0)
+                return status;
+        }
+        dp->carry -= count;
+        p += count * pb;
+        n -= count;
+    }
+    while (n > 0)
+    {
+        avail = (long) (dp->inEnd - dp->inPtr);
+        if (avail < MAXPACKET)
+            avail = FillDecoder(dp, MAXPACKET);
+        if (avail < 1)
+            return TGA_DECODE_ERROR_READ;
+        q = dp->inPtr;
+        count = (*q & 0x7f) + 1;
+        if (count > n)
+        {
+            if (!dp->wrapPackets)
+                return TGA_DECODE_ERROR_BAD_PACKET;
+            dp->carry = count - n;
+            dp->carryRun = *q & 0x80;
+            count = n;
+        }
+        if (*q & 0x80)
+        {
+            if (avail < 1 + bpp)
+                return TGA_DECODE_ERROR_READ;
+            RunPixel(dp, dp->carryPixel, q + 1);
+            dp->kernels->fill(p, dp->carryPixel, pb, count);
+            dp->inPtr = q + 1 + bpp;
+        }
+        else
+        {
+            if (avail < 1 + count * bpp)
+                return TGA_DECODE_ERROR_READ;
+            if (Converting(dp))
+                ConvertPixels(dp, p, q + 1, count);
+            else
+                memcpy(p, q + 1, count * bpp);
+            dp->inPtr = q + 1 + count * bpp;
+        }
+        p += count * pb;
+        n -= count;
+    }
+    return 0;
+}
+
+/*
+** Expand n pixels of a row of run length encoded image data to p, after
+** skipping the first skip pixels of the row.  Packets that end before
+** the first wanted pixel are passed over without being expanded.
+*/
+static int DecodeRLESpan(TGADecoder *dp, unsigned char *p, long skip, long n)
+{
+    int bpp = dp->bytesPerPixel;
+    int pb = dp->pixelBytes;
+    unsigned char pixel[4];
+    long left = dp->sp->imageWidth;
+    long count;
+    long size;
+    long avail;
+    long use;
+    unsigned char *q;
+
+    while (n > 0)
+    {
+        avail = (long) (dp->inEnd - dp->inPtr);
+        if (avail < MAXPACKET)
+            avail = FillDecoder(dp, MAXPACKET);
+        if (avail < 1)
+            return TGA_DECODE_ERROR_READ;
+        q = dp->inPtr;
+        count = (*q & 0x7f) + 1;
+        size = 1 + ((*q & 0x80) ? bpp : count * bpp);
+        if (count > left)
+            return TGA_DECODE_ERROR_BAD_PACKET;
+        if (avail < size)
+            return TGA_DECODE_ERROR_READ;
+        dp->inPtr += size;
+        left -= count;
+        if (count <= skip)
+        {
+            skip -= count;
+            continue;
+        }
+        use = count - skip < n ? count - skip : n;
+        if (*q & 0x80)
+        {
+            RunPixel(dp, pixel, q + 1);
+            dp->kernels->fill(p, pixel, pb, use);
+        }
+        else if (Converting(dp))
+            ConvertPixels(dp, p, q + 1 + skip * bpp, use);
+        else
+            memcpy(p, q + 1 + skip * bpp, use * bpp);
+        skip = 0;
+        p += use * pb;
+        n -= use;
+    }
+    return 0;
+}
+
+/*
+** Reverse the order of the pixels in a row.
+*/
+static void MirrorRow(unsigned char *p, long n, int bpp)
+{
+    unsigned char *q = p + (n - 1) * bpp;
+    unsigned char t;
+    int i;
+
+    while (p < q)
+    {
+        for (i = 0; i < bpp; ++i)
+        {
+            t = p[i];
+            p[i] = q[i];
+            q[i] = t;
+        }
+        p += bpp;
+        q -= bpp;
+    }
+}
+
+static int SetupDecoder(TGADecoder *dp, TGAFile *sp)
+{
+    switch (sp->imageType)
+    {
+    case 1:
+    case 2:
+    case 3:
+    case 9:
+    case 10:
+    case 11:
+        break;
+    default:
+        return TGA_DECODE_ERROR_IMAGE_TYPE;
+    }
+    dp->sp = sp;
+    dp->bytesPerPixel = (sp->pixelDepth + 7) >> 3;
+    if (dp->bytesPerPixel < 1 || dp->bytesPerPixel > 4)
+    {
+        return TGA_DECODE_ERROR_IMAGE_TYPE;
+    }
+    dp->rle = sp->imageType > 8;
+    dp->kernels = GetTGAKernels();
+    dp->pixelBytes = dp->bytesPerPixel;
+    dp->rowBytes = dp->pixelBytes * (long) sp->imageWidth;
+    return 0;
+}
+
+/*
+** Prepare a decoder for the image data of a file previously read with
+** ReadTGAFile.  The file is positioned at the start of the image data
+** and must not be read by other means while the decoder is in use.  A
+** file that cannot seek, such as a pipe, must already be there, and its
+** rows can only be decoded in order.  The decoder must be released with
+** FreeTGADecoder even on failure.
+*/
+int InitTGADecoder(TGADecoder *dp, FILE *fp, TGAFile *sp)
+{
+    int status;
+
+    if (dp == NULL)
+    {
+        return TGA_DECODE_ERROR_NULL_ARGUMENT;
+    }
+    memset(dp, 0, sizeof(TGADecoder));
+    if (fp == NULL || sp == NULL)
+    {
+        return TGA_DECODE_ERROR_NULL_ARGUMENT;
+    }
+    status = SetupDecoder(dp, sp);
+    if (status < 0)
+    {
+        return status;
+    }
+    dp->fp = fp;
+    dp->inOffset = GetTGADataOffset(sp);
+    if (fseek(fp, dp->inOffset, SEEK_SET) != 0 && ftell(fp) >= 0)
+    {
+        return TGA_DECODE_ERROR_SEEK;
+    }
+    dp->inSize = DECODE_BUFSIZ;
+    dp->inBuf = malloc(dp->inSize);
+    if (dp->inBuf == NULL)
+    {
+        return TGA_DECODE_ERROR_ALLOCATE;
+    }
+    dp->inPtr = dp->inEnd = dp->inBuf;
+    return 0;
+}
+
+/*
+** Prepare a decoder for the image data of a file mapped with MapTGAFile.
+** Packets are decoded directly from the mapping without any copying of
+** the compressed data.
+*/
+int InitTGAMapDecoder(TGADecoder *dp, TGAMap *mp, TGAFile *sp)
+{
+    long offset;
+    int status;
+
+    if (dp == NULL)
+    {
+        return TGA_DECODE_ERROR_NULL_ARGUMENT;
+    }
+    memset(dp, 0, sizeof(TGADecoder));
+    if (mp == NULL || sp == NULL || mp->data == NULL)
+    {
+        return TGA_DECODE_ERROR_NULL_ARGUMENT;
+    }
+    status = SetupDecoder(dp, sp);
+    if (status < 0)
+    {
+        return status;
+    }
+    offset = GetTGADataOffset(sp);
+    if (offset > mp->size)
+    {
+        return TGA_DECODE_ERROR_SEEK;
+    }
+    dp->inPtr = (unsigned char *) mp->data + offset;
+    dp->inEnd = (unsigned char *) mp->data + mp->size;
+    dp->inOffset = mp->size;
+    return 0;
+}
+
+/*
+** Decode the next row of the image, in the order stored in the file,
+** into p, which must hold at least rowBytes bytes.  Early encoders let
+** packets run on from one row into the next, which the specification
+** forbids; such images are decoded when wrapPackets is set after the
+** decoder is initialised, but only in order, by this function or by
+** DecodeTGAImage.
+*/
+int DecodeTGARow(TGADecoder *dp, unsigned char *p)
+{
+    int status;
+
+    if (dp == NULL || p == NULL)
+    {
+        return TGA_DECODE_ERROR_NULL_ARGUMENT;
+    }
+    if (dp->row >= dp->sp->imageHeight)
+    {
+        return TGA_DECODE_ERROR_READ;
+    }
+    if (dp->rle)
+        status = DecodeRLEPixels(dp, p, dp->sp->imageWidth);
+    else
+        status = DecodeRawPixels(dp, p, dp->sp->imageWidth);
+    if (status == 0 && ++dp->row == dp->sp->imageHeight && dp->carry > 0)
+        status = TGA_DECODE_ERROR_BAD_PACKET;
+    return status;
+}
+
+/*
+** Check the arguments of a whole image decode and allocate the image
+** buffer if the caller did not provide one.
+*/
+static int PrepareImage(TGADecoder *dp, unsigned char **imagep, long *stridep)
+{
+    unsigned char *image;
+
+    if (*stridep == 0)
+    {
+        *stridep = dp->rowBytes;
+    }
+    if (dp->row != 0 || *stridep < dp->rowBytes)
+    {
+        return TGA_DECODE_ERROR_ARGUMENT;
+    }
+    if (*imagep == NULL)
+    {
+        /*
+        ** The extra byte keeps an image with no rows from being taken
+        ** for a failed allocation where malloc(0) returns NULL.
+        */
+        image = malloc((size_t) *stridep * dp->sp->imageHeight + 1);
+        if (image == NULL)
+        {
+            return TGA_DECODE_ERROR_ALLOCATE;
+        }
+        dp->image = image;
+        *imagep = image;
+    }
+    return 0;
+}
+
+/*
+** Bit 5 of the image descriptor is set when the first stored row is the
+** top of the image, and bit 4 when the first stored pixel of each row is
+** the rightmost.
+*/
+static int FlipRows(TGAFile *sp, int flags)
+{
+    return ((flags & TGA_DECODE_TOP_DOWN) && !(sp->imageDesc & 0x20)) ||
+        ((flags & TGA_DECODE_BOTTOM_UP) && (sp->imageDesc & 0x20));
+}
+
+static int MirrorRows(TGAFile *sp, int flags)
+{
+    return (flags & TGA_DECODE_LEFT_RIGHT) && (sp->imageDesc & 0x10);
+}
+
+/*
+** Decode the stored rows first up to last into their place in an image
+** buffer.
+*/
+static int DecodeRows(TGADecoder *dp, unsigned char *image, long stride, long first, long last, int flip, int mirror)
+{
+    long height = dp->sp->imageHeight;
+    long row;
+    unsigned char *p;
+    int status;
+
+    for (row = first; row < last; ++row)
+    {
+        p = image + (size_t) (flip ? height - 1 - row : row) * stride;
+        if (dp->rle)
+            status = DecodeRLEPixels(dp, p, dp->sp->imageWidth);
+        else
+            status = DecodeRawPixels(dp, p, dp->sp->imageWidth);
+        if (status < 0)
+            return status;
+        if (mirror)
+            MirrorRow(p, dp->sp->imageWidth, dp->pixelBytes);
+    }
+    if (last == height && dp->carry > 0)
+        return TGA_DECODE_ERROR_BAD_PACKET;
+    return 0;
+}
+
+/*
+** Decode the whole image into one buffer of rows stride bytes apart,
+** or rowBytes apart when stride is zero.  If *imagep is NULL the buffer
+** is allocated by the decoder and released by FreeTGADecoder.  The
+** flags select the row and pixel order of the result regardless of the
+** order given by the image descriptor:
+**
+**      TGA_DECODE_TOP_DOWN     first row of the buffer is the top row
+**      TGA_DECODE_BOTTOM_UP    first row of the buffer is the bottom row
+**      TGA_DECODE_LEFT_RIGHT   first pixel of each row is the leftmost
+**
+** Without any flags the rows are left in the order stored in the file.
+*/
+int DecodeTGAImage(TGADecoder *dp, unsigned char **imagep, long stride, int flags)
+{
+    TGAFile *sp;
+    unsigned char *image;
+    long height;
+    long row;
+    int status;
+
+    if (dp == NULL || imagep == NULL)
+    {
+        return TGA_DECODE_ERROR_NULL_ARGUMENT;
+    }
+    status = PrepareImage(dp, imagep, &stride);
+    if (status < 0)
+    {
+        return status;
+    }
+    sp = dp->sp;
+    height = sp->imageHeight;
+    image = *imagep;
+
+    if (!FlipRows(sp, flags) && stride == dp->rowBytes && dp->rowBytes > 0 && height <= LONG_MAX / dp->rowBytes &&
+        (!dp->rle || dp->wrapPackets))
+    {
+        /*
+        ** The rows are contiguous and in stored order, so the image data
+        ** can be decoded in a single operation.  Run length packets are
+        ** only checked against the ends of rows when decoded a row at a
+        ** time, so this is done only when packets may wrap anyway.
+        */
+        if (dp->rle)
+            status = DecodeRLEPixels(dp, image, (long) sp->imageWidth * height);
+        else
+            status = DecodeRawPixels(dp, image, (long) sp->imageWidth * height);
+        if (status < 0)
+            return status;
+        if (MirrorRows(sp, flags))
+        {
+            for (row = 0; row < height; ++row)
+            {
+                MirrorRow(image + (size_t) row * stride, sp->imageWidth, dp->pixelBytes);
+            }
+        }
+    }
+    else
+    {
+        status = DecodeRows(dp, image, stride, 0, height, FlipRows(sp, flags), MirrorRows(sp, flags));
+        if (status < 0)
+            return status;
+    }
+    dp->row = height;
+    return 0;
+}
+
+/*
+** Walk the packet headers from the start of the image data, recording
+** the offset of each stored row, without expanding any pixels.
+*/
+static int IndexRows(TGADecoder *dp, UINT32 *offsets)
+{
+    long row;
+    long n;
+    long count;
+    long size;
+    long avail;
+    int bpp = dp->bytesPerPixel;
+
+    for (row = 0; row < dp->sp->imageHeight; ++row)
+    {
+        offsets[row] = (UINT32) TellDecoder(dp);
+        for (n = dp->sp->imageWidth; n > 0; n -= count)
+        {
+            avail = (long) (dp->inEnd - dp->inPtr);
+            if (avail < MAXPACKET)
+                avail = FillDecoder(dp, MAXPACKET);
+            if (avail < 1)
+                return TGA_DECODE_ERROR_READ;
+            count = (*dp->inPtr & 0x7f) + 1;
+            size = 1 + ((*dp->inPtr & 0x80) ? bpp : count * bpp);
+            if (count > n)
+                return TGA_DECODE_ERROR_BAD_PACKET;
+            if (avail < size)
+                return TGA_DECODE_ERROR_READ;
+            dp->inPtr += size;
+        }
+    }
+    return 0;
+}
+
+/*
+** Record the file offset of the start of each stored row in offsets,
+** which must hold imageHeight entries.  Run length encoded data is
+** indexed by walking the packet headers without expanding any pixels.
+** The decoder must not have decoded any rows, and is returned to the
+** first row afterwards.
+*/
+int IndexTGARows(TGADecoder *dp, UINT32 *offsets)
+{
+    long base;
+    long row;
+    int status;
+
+    if (dp == NULL || offsets == NULL)
+    {
+        return TGA_DECODE_ERROR_NULL_ARGUMENT;
+    }
+    if (dp->row != 0)
+    {
+        return TGA_DECODE_ERROR_ARGUMENT;
+    }
+    base = GetTGADataOffset(dp->sp);
+    if (!dp->rle)
+    {
+        for (row = 0; row < dp->sp->imageHeight; ++row)
+        {
+            offsets[row] = (UINT32) (base + row * StoredRowBytes(dp));
+        }
+        return 0;
+    }
+    status = IndexRows(dp, offsets);
+    if (SeekDecoder(dp, base) < 0 && status == 0)
+    {
+        status = TGA_DECODE_ERROR_SEEK;
+    }
+    return status;
+}
+
+/*
+** Copy n bytes of image data to ofp straight from the input buffer.
+*/
+static int CopyRawBytes(TGADecoder *dp, FILE *ofp, long n)
+{
+    long avail;
+
+    while (n > 0)
+    {
+        avail = (long) (dp->inEnd - dp->inPtr);
+        if (avail < 1)
+            avail = FillDecoder(dp, 1);
+        if (avail < 1)
+            return TGA_DECODE_ERROR_READ;
+        if (avail > n)
+            avail = n;
+        if (fwrite(dp->inPtr, 1, avail, ofp) != (size_t) avail)
+            return TGA_DECODE_ERROR_WRITE;
+        dp->inPtr += avail;
+        n -= avail;
+    }
+    return 0;
+}
+
+/*
+** Copy the image data to ofp unchanged, recording in offsets, when it is
+** not NULL, the position of the start of each stored row as written,
+** counting from base.  Packets are copied as they are found, so the
+** offsets cost no extra pass over the data, and uncompressed data from
+** a file is copied with file_copy.  Run length packets crossing rows
+** are copied as they are when offsets is NULL, and otherwise refused
+** with TGA_DECODE_ERROR_BAD_PACKET, since rows starting part way into
+** a packet have no offset.  Returns the number of bytes copied, or a
+** negative error code.
+*/
+long CopyTGARows(TGADecoder *dp, FILE *ofp, long base, UINT32 *offsets)
+{
+    unsigned char *mark;
+    long offset = 0;
+    long row;
+    long n;
+    long count;
+    long size;
+    long avail;
+    int bpp;
+    int status;
+
+    if (dp == NULL || ofp == NULL)
+    {
+        return TGA_DECODE_ERROR_NULL_ARGUMENT;
+    }
+    if (dp->row != 0)
+    {
+        return TGA_DECODE_ERROR_ARGUMENT;
+    }
+    if (!dp->rle)
+    {
+        for (row = 0; row < dp->sp->imageHeight; ++row)
+        {
+            if (offsets != NULL)
+                offsets[row] = (UINT32) (base + row * StoredRowBytes(dp));
+        }
+        size = row * StoredRowBytes(dp);
+        if (dp->fp != NULL && dp->inPtr == dp->inEnd)
+        {
+            /*
+            ** Uncompressed data is copied in one piece, within the
+            ** kernel where possible, and the decoder moved past it.
+            */
+            count = file_copy(dp->fp, dp->inOffset, ofp, size);
+            if (count >= 0)
+            {
+                if (count != size)
+                    return TGA_DECODE_ERROR_READ;
+                dp->inOffset += size;
+                if (!dp->positioned && fseek(dp->fp, dp->inOffset, SEEK_SET) != 0)
+                    return TGA_DECODE_ERROR_SEEK;
+                dp->row = row;
+                return size;
+            }
+        }
+        status = CopyRawBytes(dp, ofp, size);
+        if (status < 0)
+            return status;
+        dp->row = row;
+        return size;
+    }
+
+    /*
+    ** The packets between mark and inPtr have been checked but not yet
+    ** written; they are written whenever the buffer is about to move.
+    */
+    bpp = dp->bytesPerPixel;
+    mark = dp->inPtr;
+    n = 0;
+    for (row = 0; row < dp->sp->imageHeight; ++row)
+    {
+        if (offsets != NULL)
+            offsets[row] = (UINT32) (base + offset);
+        /*
+        ** A packet that ran on from the previous row leaves n negative,
+        ** covering the start of this one.
+        */
+        for (n += dp->sp->imageWidth; n > 0; n -= count)
+        {
+            avail = (long) (dp->inEnd - dp->inPtr);
+            if (avail < MAXPACKET)
+            {
+                if (fwrite(mark, 1, dp->inPtr - mark, ofp) != (size_t) (dp->inPtr - mark))
+                    return TGA_DECODE_ERROR_WRITE;
+                avail = FillDecoder(dp, MAXPACKET);
+                mark = dp->inPtr;
+            }
+            if (avail < 1)
+                return TGA_DECODE_ERROR_READ;
+            count = (*dp->inPtr & 0x7f) + 1;
+            size = 1 + ((*dp->inPtr & 0x80) ? bpp : count * bpp);
+            if (count > n && offsets != NULL)
+                return TGA_DECODE_ERROR_BAD_PACKET;
+            if (avail < size)
+                return TGA_DECODE_ERROR_READ;
+            dp->inPtr += size;
+            offset += size;
+        }
+    }
+    if (n < 0)
+        return TGA_DECODE_ERROR_BAD_PACKET;
+    if (fwrite(mark, 1, dp->inPtr - mark, ofp) != (size_t) (dp->inPtr - mark))
+        return TGA_DECODE_ERROR_WRITE;
+    dp->row = row;
+    return offset;
+}
+
+/*
+** A scan line table is only trusted when it starts at the image data and
+** every row occupies a possible number of bytes.
+*/
+static int CheckRowOffsets(TGADecoder *dp, const UINT32 *offsets)
+{
+    long width = dp->sp->imageWidth;
+    long least = ((width + 127) / 128) * (1 + dp->bytesPerPixel);
+    long most = width * (1 + dp->bytesPerPixel);
+    long row;
+    long size;
+
+    if (offsets[0] != (UINT32) GetTGADataOffset(dp->sp))
+        return 0;
+    for (row = 1; row < dp->sp->imageHeight; ++row)
+    {
+        size = (long) (offsets[row] - offsets[row - 1]);
+        if (offsets[row] < offsets[row - 1] || size < least || size > most)
+            return 0;
+    }
+    return 1;
+}
+
+/*
+** Make a private copy of a decoder that reads the same image data
+** independently, with its own input buffer when reading from a file.
+** The copy must be moved with SeekDecoder before it is used, and its
+** buffer released with free.  Copies reading from a file share the
+** stream, so unless positioned reads are available only one may be in
+** use at a time, and the stream must be repositioned afterwards.
+*/
+static int CopyDecoder(TGADecoder *dp, TGADecoder *cp)
+{
+    *cp = *dp;
+    cp->image = NULL;
+    cp->rowOffsets = NULL;
+    if (dp->fp != NULL)
+    {
+        cp->inBuf = malloc(dp->inSize);
+        if (cp->inBuf == NULL)
+        {
+            return TGA_DECODE_ERROR_ALLOCATE;
+        }
+        cp->inPtr = cp->inEnd = cp->inBuf;
+        cp->inOffset = -1;
+        cp->positioned = file_read_at(dp->fp, NULL, 0, 0) >= 0;
+    }
+    return 0;
+}
+
+/*
+** Find the offset of each stored row, from the scan line table when it
+** can be trusted, or otherwise from an index built by the decoder the
+** first time it is needed.
+*/
+static int GetRowOffsets(TGADecoder *dp, const UINT32 **offsetsp)
+{
+    const UINT32 *table;
+    TGADecoder index;
+    UINT32 *offsets;
+    long saved = 0;
+    long row;
+    int status;
+
+    table = dp->rle ? GetTGAScanLineTable(dp->sp) : NULL;
+    if (table != NULL && CheckRowOffsets(dp, table))
+    {
+        *offsetsp = table;
+        return 0;
+    }
+    if (dp->rowOffsets == NULL)
+    {
+        offsets = malloc(dp->sp->imageHeight * sizeof(UINT32));
+        if (offsets == NULL)
+        {
+            return TGA_DECODE_ERROR_ALLOCATE;
+        }
+        if (!dp->rle)
+        {
+            for (row = 0; row < dp->sp->imageHeight; ++row)
+            {
+                offsets[row] = (UINT32) (GetTGADataOffset(dp->sp) + row * StoredRowBytes(dp));
+            }
+            dp->rowOffsets = offsets;
+            *offsetsp = offsets;
+            return 0;
+        }
+        if (dp->fp != NULL)
+        {
+            saved = ftell(dp->fp);
+        }
+        status = CopyDecoder(dp, &index);
+        if (status == 0)
+            status = SeekDecoder(&index, GetTGADataOffset(dp->sp));
+        if (status == 0)
+            status = IndexRows(&index, offsets);
+        free(index.inBuf);
+        if (dp->fp != NULL && fseek(dp->fp, saved, SEEK_SET) != 0 && status == 0)
+        {
+            status = TGA_DECODE_ERROR_SEEK;
+        }
+        if (status < 0)
+        {
+            free(offsets);
+            return status;
+        }
+        dp->rowOffsets = offsets;
+    }
+    *offsetsp = dp->rowOffsets;
+    return 0;
+}
+
+/*
+** Return the offset of each stored row, which is valid until the decoder
+** is released.  Unlike IndexTGARows this may be used at any point while
+** decoding, and reuses the scan line table or an index already built.
+*/
+int GetTGARowOffsets(TGADecoder *dp, const UINT32 **offsetsp)
+{
+    if (dp == NULL || offsetsp == NULL)
+    {
+        return TGA_DECODE_ERROR_NULL_ARGUMENT;
+    }
+    return GetRowOffsets(dp, offsetsp);
+}
+
+/*
+** Give the decoder a copy of an index of its rows built earlier, such as
+** one kept in a cache or a sidecar file, so that it need not build one.
+** The index is rejected unless it is consistent with the image.
+*/
+int SetTGARowOffsets(TGADecoder *dp, const UINT32 *offsets)
+{
+    UINT32 *copy;
+    size_t size;
+
+    if (dp == NULL || offsets == NULL)
+    {
+        return TGA_DECODE_ERROR_NULL_ARGUMENT;
+    }
+    if (dp->sp->imageHeight == 0 || !CheckRowOffsets(dp, offsets))
+    {
+        return TGA_DECODE_ERROR_ARGUMENT;
+    }
+    size = dp->sp->imageHeight * sizeof(UINT32);
+    copy = malloc(size);
+    if (copy == NULL)
+    {
+        return TGA_DECODE_ERROR_ALLOCATE;
+    }
+    memcpy(copy, offsets, size);
+    free(dp->rowOffsets);
+    dp->rowOffsets = copy;
+    return 0;
+}
+
+/*
+** Widen a color map entry of 2 to 4 bytes to a pixel of 8 bit blue,
+** green, red and alpha.  Entries of 2 bytes hold 5 bits of each color.
+*/
+static void ExpandEntry(unsigned char *e, const unsigned char *q, int entryBytes)
+{
+    unsigned int v;
+    int c;
+
+    switch (entryBytes)
+    {
+    case 2:
+        v = q[0] | (q[1] << 8);
+        for (c = 0; c < 3; ++c, v >>= 5)
+            e[c] = (unsigned char) (((v & 0x1f) << 3) | ((v & 0x1f) >> 2));
+        e[3] = 0xff;
+        break;
+    case 3:
+        memcpy(e, q, 3);
+        e[3] = 0xff;
+        break;
+    default:
+        memcpy(e, q, 4);
+        break;
+    }
+}
+
+/*
+** Decode the indices of a color mapped image as the true color pixels,
+** of bytesPerPixel bytes, 3 or 4, that they select from colormap, the
+** color map entries as stored in the file.  When colormap is NULL the
+** entries are read from the file or mapping, which must then be able to
+** seek.  Entries of 15, 16 and 24 bits are opaque, and indices outside
+** the color map give transparent black.  The decoder must not have
+** decoded any rows, and afterwards rowBytes is the size of an expanded
+** row.  Every decode then expands the indices through a table holding
+** a color for each possible index, straight from the input buffer and
+** once per run packet, with no intermediate row of indices.
+*/
+int ExpandTGAColormap(TGADecoder *dp, const unsigned char *colormap, int bytesPerPixel)
+{
+    TGAFile *sp;
+    unsigned char *map = NULL;
+    long entries;
+    long index;
+    long size;
+    long saved;
+    long i;
+    int entryBytes;
+    int status = 0;
+
+    if (dp == NULL || dp->sp == NULL)
+    {
+        return TGA_DECODE_ERROR_NULL_ARGUMENT;
+    }
+    sp = dp->sp;
+    entryBytes = (sp->mapWidth + 7) >> 3;
+    if ((sp->imageType != 1 && sp->imageType != 9) || dp->bytesPerPixel > 2 ||
+        sp->mapLength == 0 || entryBytes < 2 || entryBytes > 4)
+    {
+        return TGA_DECODE_ERROR_IMAGE_TYPE;
+    }
+    if ((bytesPerPixel != 3 && bytesPerPixel != 4) || dp->row != 0 || dp->colors != NULL)
+    {
+        return TGA_DECODE_ERROR_ARGUMENT;
+    }
+    size = entryBytes * (long) sp->mapLength;
+    if (colormap == NULL && dp->fp == NULL)
+    {
+        /*
+        ** The color map is part of the mapping, ahead of the image data.
+        */
+        colormap = dp->inEnd - dp->inOffset + 18 + sp->idLength;
+    }
+    else if (colormap == NULL)
+    {
+        map = malloc(size);
+        if (map == NULL)
+        {
+            return TGA_DECODE_ERROR_ALLOCATE;
+        }
+        saved = ftell(dp->fp);
+        if (saved < 0 || fseek(dp->fp, 18L + sp->idLength, SEEK_SET) != 0)
+            status = TGA_DECODE_ERROR_SEEK;
+        else if (fread(map, 1, size, dp->fp) != (size_t) size)
+            status = TGA_DECODE_ERROR_READ;
+        if (saved >= 0 && fseek(dp->fp, saved, SEEK_SET) != 0 && status == 0)
+            status = TGA_DECODE_ERROR_SEEK;
+        colormap = map;
+    }
+
+    entries = dp->bytesPerPixel == 1 ? 256 : 65536;
+    dp->colors = status == 0 ? calloc(entries, sizeof(UINT32)) : NULL;
+    if (dp->colors == NULL && status == 0)
+    {
+        status = TGA_DECODE_ERROR_ALLOCATE;
+    }
+    for (i = 0; i < sp->mapLength && status == 0; ++i)
+    {
+        index = sp->mapOrigin + i;
+        if (index >= entries)
+            break;
+        ExpandEntry((unsigned char *) &dp->colors[index], colormap + i * entryBytes, entryBytes);
+    }
+    free(map);
+    if (status == 0)
+    {
+        dp->pixelBytes = bytesPerPixel;
+        dp->rowBytes = bytesPerPixel * (long) sp->imageWidth;
+    }
+    return status;
+}
+
+/*
+** Decode the 16 bit pixels of a true color image as pixels of 8 bits
+** per channel, of bytesPerPixel bytes, 3 or 4.  Alpha comes from the
+** attribute bit when the image descriptor gives the pixels one, and
+** otherwise every pixel is opaque.  The decoder must not have decoded
+** any rows, and afterwards rowBytes is the size of a widened row.  Each
+** pixel is widened as it is decoded, straight from the input buffer and
+** once per run packet, with no intermediate row of 16 bit pixels.
+*/
+int SetTGADecodeFormat(TGADecoder *dp, int bytesPerPixel)
+{
+    TGAFile *sp;
+
+    if (dp == NULL || dp->sp == NULL)
+    {
+        return TGA_DECODE_ERROR_NULL_ARGUMENT;
+    }
+    sp = dp->sp;
+    if ((sp->imageType != 2 && sp->imageType != 10) || dp->bytesPerPixel != 2)
+    {
+        return TGA_DECODE_ERROR_IMAGE_TYPE;
+    }
+    if ((bytesPerPixel != 3 && bytesPerPixel != 4) || dp->row != 0 || dp->pixelBytes != dp->bytesPerPixel)
+    {
+        return TGA_DECODE_ERROR_ARGUMENT;
+    }
+    dp->convertFlags = (sp->imageDesc & 0x0f) == 0 ? TGA_CONVERT_NO_ALPHA : 0;
+    dp->pixelBytes = bytesPerPixel;
+    dp->rowBytes = bytesPerPixel * (long) sp->imageWidth;
+    return 0;
+}
+
+/*
+** Correct the colors of decoded pixels of 3 or 4 bytes as described in
+** the extension area of the file.  With TGA_CORRECT_TABLE each byte is
+** replaced by its entry in the color correction table, and then with
+** TGA_CORRECT_GAMMA each color is raised to the power of one over the
+** gamma value.  Corrections the file does not have are left out, and
+** when none remain the pixels are decoded unchanged.  The decoder must
+** not have decoded any rows, and color maps must already be expanded.
+** Both corrections are combined into one table per byte of a pixel, so
+** each byte is looked up once as it is decoded, straight from the input
+** buffer and once per run packet; for color mapped images the expanded
+** color map itself is corrected instead.
+*/
+int SetTGAColorCorrection(TGADecoder *dp, int flags)
+{
+    TGAFile *sp;
+    const UINT16 *table = NULL;
+    unsigned char *e;
+    UINT32 *tables;
+    double gamma = 1.0;
+    double v;
+    int c;
+    int i;
+
+    if (dp == NULL || dp->sp == NULL)
+    {
+        return TGA_DECODE_ERROR_NULL_ARGUMENT;
+    }
+    sp = dp->sp;
+    if (dp->pixelBytes != 3 && dp->pixelBytes != 4)
+    {
+        return TGA_DECODE_ERROR_IMAGE_TYPE;
+    }
+    if (dp->row != 0 || dp->correct != NULL)
+    {
+        return TGA_DECODE_ERROR_ARGUMENT;
+    }
+    if (flags & TGA_CORRECT_TABLE)
+    {
+        table = GetTGAColorCorrectTable(sp);
+    }
+    if ((flags & TGA_CORRECT_GAMMA) && sp->gammaNumerator != 0 && sp->gammaDenominator != 0)
+    {
+        gamma = (double) sp->gammaNumerator / sp->gammaDenominator;
+    }
+    if (table == NULL && gamma == 1.0)
+    {
+        return 0;
+    }
+    tables = calloc(4 * 256, sizeof(UINT32));
+    if (tables == NULL)
+    {
+        return TGA_DECODE_ERROR_ALLOCATE;
+    }
+
+    /*
+    ** Table entries hold alpha, red, green and blue, the reverse of the
+    ** order of the bytes of a pixel.  Gamma leaves alpha alone.
+    */
+    for (c = 0; c < 4; ++c)
+    {
+        for (i = 0; i < 256; ++i)
+        {
+            v = table != NULL ? table[4 * i + 3 - c] / 65535.0 : i / 255.0;
+            if (c < 3 && gamma != 1.0)
+                v = pow(v, 1.0 / gamma);
+            e = (unsigned char *) &tables[c * 256 + i];
+            e[c] = (unsigned char) (v * 255.0 + 0.5);
+        }
+    }
+    if (dp->colors != NULL)
+    {
+        dp->kernels->lookup((unsigned char *) dp->colors, (unsigned char *) dp->colors,
+                            dp->bytesPerPixel == 1 ? 256 : 65536, 4, tables);
+    }
+    dp->correct = tables;
+    return 0;
+}
+
+/*
+** Return the offset of a stored row, plus the offset of a pixel within
+** it for uncompressed data.
+*/
+static long RowOffset(TGADecoder *dp, const UINT32 *offsets, long row, long col)
+{
+    if (dp->rle)
+        return (long) offsets[row];
+    return GetTGADataOffset(dp->sp) + row * StoredRowBytes(dp) + col * dp->bytesPerPixel;
+}
+
+typedef struct _DecodeBand
+{
+    TGADecoder decoder;         /* private decoder for the rows of the band */
+    unsigned char *image;
+    long stride;
+    long first;                 /* first stored row of the band */
+    long last;                  /* row following the band */
+    long end;                   /* offset of the row following the band */
+    int flip;
+    int mirror;
+    int status;
+} DecodeBand;
+
+static void DecodeBandJob(void *arg)
+{
+    DecodeBand *bp = arg;
+
+    bp->status = DecodeRows(&bp->decoder, bp->image, bp->stride, bp->first, bp->last, bp->flip, bp->mirror);
+    if (bp->status == 0 && bp->end >= 0 && TellDecoder(&bp->decoder) != bp->end)
+        bp->status = TGA_DECODE_ERROR_BAD_PACKET;
+    bp->end = TellDecoder(&bp->decoder);
+}
+
+/*
+** Decode the whole image like DecodeTGAImage, but split the rows into
+** bands that are decoded concurrently on up to threads threads.  Each
+** band starts at its own offset into the file, taken from the scan line
+** table when the file has a usable one, or otherwise from a serial pass
+** over the packet headers.  A decoder reading from a file uses
+** positioned reads, and falls back to decoding serially on platforms
+** that do not support them, or when packets may wrap between rows.
+*/
+int DecodeTGAImageParallel(TGADecoder *dp, unsigned char **imagep, long stride, int flags, int threads)
+{
+    TGAFile *sp;
+    TGAPool *pool;
+    DecodeBand *bands;
+    DecodeBand *bp;
+    const UINT32 *offsets = NULL;
+    long height;
+    long end;
+    int count;
+    int i;
+    int status;
+
+    if (dp == NULL || imagep == NULL)
+    {
+        return TGA_DECODE_ERROR_NULL_ARGUMENT;
+    }
+    sp = dp->sp;
+    height = sp->imageHeight;
+    if (threads < 2 || height < 2 || dp->wrapPackets ||
+        (dp->fp != NULL && file_read_at(dp->fp, NULL, 0, 0) < 0))
+    {
+        return DecodeTGAImage(dp, imagep, stride, flags);
+    }
+    status = PrepareImage(dp, imagep, &stride);
+    if (status == 0 && dp->rle)
+    {
+        status = GetRowOffsets(dp, &offsets);
+    }
+    if (status < 0)
+    {
+        return status;
+    }
+
+    /*
+    ** Several bands per thread even out differences in the time taken
+    ** to decode different parts of the image.
+    */
+    count = threads * 4;
+    if (count > height)
+    {
+        count = (int) height;
+    }
+    bands = calloc(count, sizeof(DecodeBand));
+    if (bands == NULL)
+    {
+        return TGA_DECODE_ERROR_ALLOCATE;
+    }
+    for (i = 0; i < count && status == 0; ++i)
+    {
+        bp = &bands[i];
+        bp->image = *imagep;
+        bp->stride = stride;
+        bp->first = height * i / count;
+        bp->last = height * (i + 1) / count;
+        bp->end = bp->last < height ? RowOffset(dp, offsets, bp->last, 0) : -1;
+        bp->flip = FlipRows(sp, flags);
+        bp->mirror = MirrorRows(sp, flags);
+        status = CopyDecoder(dp, &bp->decoder);
+        if (status == 0)
+            status = SeekDecoder(&bp->decoder, RowOffset(dp, offsets, bp->first, 0));
+    }
+
+    if (status == 0)
+    {
+        pool = CreateTGAPool(threads);
+        if (pool == NULL)
+        {
+            status = TGA_DECODE_ERROR_ALLOCATE;
+        }
+        else
+        {
+            for (i = 0; i < count; ++i)
+            {
+                SubmitTGAJob(pool, DecodeBandJob, &bands[i]);
+            }
+            DestroyTGAPool(pool);
+            for (i = 0; i < count && status == 0; ++i)
+            {
+                status = bands[i].status;
+            }
+        }
+    }
+
+    /*
+    ** Leave the decoder positioned after the image data, as if it had
+    ** been decoded serially.
+    */
+    if (status == 0)
+    {
+        end = bands[count - 1].end;
+        if (dp->fp == NULL)
+        {
+            status = SeekDecoder(dp, end);
+        }
+        else
+        {
+            dp->inPtr = dp->inEnd = dp->inBuf;
+            dp->inOffset = end;
+            if (fseek(dp->fp, end, SEEK_SET) != 0)
+                status = TGA_DECODE_ERROR_SEEK;
+        }
+        dp->row = height;
+    }
+    for (i = 0; i < count; ++i)
+    {
+        free(bands[i].decoder.inBuf);
+    }
+    free(bands);
+    return status;
+}
+
+/*
+** Decode a window of w by h pixels, starting x pixels into row y, into
+** a buffer of rows stride bytes apart, or w pixels apart when stride is
+** zero.  The flags are those of DecodeTGAImage; they select both how x
+** and y are counted and the order of the result, and without any flags
+** both count from the first stored row and pixel.  Uncompressed rows
+** are read from just the wanted columns.  Run length encoded rows are
+** found with the scan line table, or with an index of the rows built by
+** the decoder on first use, and packets before the window are skipped
+** without being expanded.  Rows decoded with DecodeTGARow are not
+** affected.
+*/
+int DecodeTGARegion(TGADecoder *dp, int x, int y, int w, int h, unsigned char *p, long stride, int flags)
+{
+    TGADecoder region;
+    TGAFile *sp;
+    const UINT32 *offsets = NULL;
+    unsigned char *q;
+    long first;
+    long col;
+    long row;
+    long saved = 0;
+    int flip;
+    int mirror;
+    int status = 0;
+    int i;
+
+    if (dp == NULL || p == NULL)
+    {
+        return TGA_DECODE_ERROR_NULL_ARGUMENT;
+    }
+    sp = dp->sp;
+    if (stride == 0)
+    {
+        stride = (long) w * dp->pixelBytes;
+    }
+    if (x < 0 || y < 0 || w < 0 || h < 0 || (long) x + w > sp->imageWidth ||
+        (long) y + h > sp->imageHeight || stride < (long) w * dp->pixelBytes)
+    {
+        return TGA_DECODE_ERROR_ARGUMENT;
+    }
+    if (w == 0 || h == 0)
+    {
+        return 0;
+    }
+    flip = FlipRows(sp, flags);
+    mirror = MirrorRows(sp, flags);
+    first = flip ? sp->imageHeight - y - h : y;
+    col = mirror ? sp->imageWidth - x - w : x;
+
+    if (dp->fp != NULL)
+    {
+        saved = ftell(dp->fp);
+    }
+    if (dp->rle)
+    {
+        status = GetRowOffsets(dp, &offsets);
+    }
+    if (status == 0)
+    {
+        status = CopyDecoder(dp, &region);
+        for (i = 0; i < h && status == 0; ++i)
+        {
+            row = first + i;
+            q = p + (size_t) (flip ? h - 1 - i : i) * stride;
+            status = SeekDecoder(&region, RowOffset(dp, offsets, row, col));
+            if (status < 0)
+                break;
+            if (dp->rle)
+                status = DecodeRLESpan(&region, q, col, w);
+            else
+                status = DecodeRawPixels(&region, q, w);
+            if (status == 0 && mirror)
+                MirrorRow(q, w, dp->pixelBytes);
+        }
+        free(region.inBuf);
+    }
+
+    /*
+    ** Restore the stream for the sequential decoder.
+    */
+    if (dp->fp != NULL && fseek(dp->fp, saved, SEEK_SET) != 0 && status == 0)
+    {
+        status = TGA_DECODE_ERROR_SEEK;
+    }
+    return status;
+}
+
+void FreeTGADecoder(TGADecoder *dp)
+{
+    if (dp->rowOffsets)
+    {
+        free(dp->rowOffsets);
+        dp->rowOffsets = NULL;
+    }
+    if (dp->colors)
+    {
+        free(dp->colors);
+        dp->colors = NULL;
+    }
+    if (dp->correct)
+    {
+        free(dp->correct);
+        dp->correct = NULL;
+    }
+    if (dp->image)
+    {
+        free(dp->image);
+        dp->image = NULL;
+    }
+    /*
+    ** Only a decoder reading from a file owns its input buffer.
+    */
+    if (dp->inBuf)
+    {
+        free(dp->inBuf);
+        dp->inBuf = NULL;
+    }
+    dp->inPtr = dp->inEnd = NULL;
+}
@@ -0,0 +1,304 @@
+#include <stdlib.h>
+#include <tga.h>
+
+#include <config/thread.h>
+
+#include "pool.h"
+
+#define BAND_BYTES 262144 /* approximate size of the rows in one band */
+
+/*
+** The image is encoded in bands of whole rows.  Packets never cross a
+** row, so every band can be encoded independently; the bands are then
+** written in order as each one completes.
+*/
+typedef struct _EncodeBand
+{
+    struct _EncodeState *state;
+    unsigned char *raw;    /* decoded rows of the band */
+    unsigned char *packed; /* run length encoded rows of the band */
+    long first;            /* image row of the first row of the band */
+    long rows;             /* number of rows in the band */
+    long packedSize;       /* bytes of encoded data */
+    int busy;              /* set while the band is queued or being encoded */
+} EncodeBand;
+
+typedef struct _EncodeState
+{
+    thread_mutex mutex;
+    thread_cond cond;
+    int width;
+    int bpp;
+    long rowBytes;
+    int srcBpp;            /* bytes per decoded pixel */
+    int convertFlags;      /* flags for narrowing, or -1 to encode as decoded */
+    int (*encode)(char *p, char *q, int n, int bpp);
+} EncodeState;
+
+/*
+** Narrowing to 16 bits clears the attribute bit of 3 byte pixels, which
+** have no alpha to keep in it.
+*/
+static int NarrowFlags(TGADecoder *dp, int flags)
+{
+    if (!(flags & TGA_ENCODE_NARROW))
+        return -1;
+    return (dp->pixelBytes == 3 ? TGA_CONVERT_NO_ALPHA : 0) | ((flags & TGA_ENCODE_DITHER) ? TGA_CONVERT_DITHER : 0);
+}
+
+static void EncodeBandJob(void *arg)
+{
+    EncodeBand *bp = arg;
+    EncodeState *state = bp->state;
+    unsigned char *p = bp->raw;
+    unsigned char *q = bp->packed;
+    long row;
+
+    for (row = 0; row < bp->rows; ++row)
+    {
+        if (state->convertFlags >= 0)
+            NarrowTGAPixels(p, p, state->width, state->srcBpp, state->convertFlags, bp->first + row);
+        q += state->encode((char *) p, (char *) q, state->width, state->bpp);
+        p += state->rowBytes;
+    }
+    thread_mutex_lock(state->mutex);
+    bp->packedSize = (long) (q - bp->packed);
+    bp->busy = 0;
+    thread_cond_broadcast(state->cond);
+    thread_mutex_unlock(state->mutex);
+}
+
+static void WaitBand(EncodeBand *bp)
+{
+    EncodeState *state = bp->state;
+
+    thread_mutex_lock(state->mutex);
+    while (bp->busy)
+        thread_cond_wait(state->cond, state->mutex);
+    thread_mutex_unlock(state->mutex);
+}
+
+/*
+** Write the band queued in a slot, if any, once it has been encoded.
+*/
+static int FlushBand(EncodeBand *bp, FILE *ofp)
+{
+    long size;
+
+    if (bp->rows == 0)
+        return 0;
+    WaitBand(bp);
+    size = bp->packedSize;
+    bp->rows = 0;
+    if (fwrite(bp->packed, 1, size, ofp) != (size_t) size)
+        return TGA_ENCODE_ERROR_WRITE;
+    return 0;
+}
+
+/*
+** Run length encode the rest of the image read by a decoder and write
+** it to ofp.  With more than one thread, bands of rows are encoded
+** concurrently while the calling thread decodes the following rows and
+** writes completed bands in order, so the output is the same as that
+** of encoding the rows one at a time.  With TGA_ENCODE_OPTIMAL in flags
+** each row is encoded with RLEncodeRowOptimal instead of RLEncodeRow.
+** With TGA_ENCODE_NARROW the decoded pixels, of 3 or 4 bytes, are cut
+** to 16 bits as by NarrowTGAPixels on the band thread before encoding,
+** and dithered with TGA_ENCODE_DITHER.
+*/
+int EncodeTGAImage(TGADecoder *dp, FILE *ofp, int threads, int flags)
+{
+    EncodeState state;
+    EncodeBand *bands;
+    EncodeBand *bp = NULL;
+    TGAPool *pool;
+    long bandRows;
+    long row;
+    long height;
+    long i;
+    int slots;
+    int slot;
+    int status = 0;
+
+    if (dp == NULL || ofp == NULL || dp->sp == NULL)
+    {
+        return TGA_ENCODE_ERROR_NULL_ARGUMENT;
+    }
+    if (threads < 1)
+    {
+        threads = 1;
+    }
+    state.convertFlags = NarrowFlags(dp, flags);
+    if (state.convertFlags >= 0 && dp->pixelBytes != 3 && dp->pixelBytes != 4)
+    {
+        return TGA_ENCODE_ERROR_ARGUMENT;
+    }
+    state.width = dp->sp->imageWidth;
+    state.srcBpp = dp->pixelBytes;
+    state.bpp = state.convertFlags >= 0 ? 2 : dp->pixelBytes;
+    state.rowBytes = dp->rowBytes;
+    state.encode = (flags & TGA_ENCODE_OPTIMAL) ? RLEncodeRowOptimal : RLEncodeRow;
+    height = dp->sp->imageHeight;
+    if (state.rowBytes == 0 || dp->row >= height)
+    {
+        return 0;
+    }
+    bandRows = BAND_BYTES / state.rowBytes;
+    if (bandRows < 1)
+    {
+        bandRows = 1;
+    }
+
+    /*
+    ** Two bands per thread keep the workers busy while the oldest band
+    ** waits to be written.
+    */
+    slots = threads > 1 ? 2 * threads : 1;
+    bands = calloc(slots, sizeof(EncodeBand));
+    if (bands == NULL)
+    {
+        return TGA_ENCODE_ERROR_ALLOCATE;
+    }
+    state.mutex = NULL;
+    state.cond = NULL;
+    pool = NULL;
+    if (thread_mutex_create(&state.mutex) < 0 || thread_cond_create(&state.cond) < 0)
+    {
+        status = TGA_ENCODE_ERROR_ALLOCATE;
+    }
+    for (slot = 0; slot < slots && status == 0; ++slot)
+    {
+        bands[slot].state = &state;
+        bands[slot].raw = malloc((size_t) bandRows * state.rowBytes);
+        bands[slot].packed = malloc((size_t) bandRows * state.width * (state.bpp + 1));
+        if (bands[slot].raw == NULL || bands[slot].packed == NULL)
+            status = TGA_ENCODE_ERROR_ALLOCATE;
+    }
+    if (status == 0)
+    {
+        pool = CreateTGAPool(threads);
+        if (pool == NULL)
+            status = TGA_ENCODE_ERROR_ALLOCATE;
+    }
+
+    slot = 0;
+    for (row = dp->row; row < height && status == 0; row += bp->rows)
+    {
+        bp = &bands[slot];
+        status = FlushBand(bp, ofp);
+        if (status < 0)
+            break;
+        for (i = 0; i < bandRows && row + i < height; ++i)
+        {
+            if (DecodeTGARow(dp, bp->raw + i * state.rowBytes) < 0)
+            {
+                status = TGA_ENCODE_ERROR_READ;
+                break;
+            }
+        }
+        if (status < 0)
+            break;
+        bp->first = row;
+        bp->rows = i;
+        bp->busy = 1;
+        SubmitTGAJob(pool, EncodeBandJob, bp);
+        slot = (slot + 1) % slots;
+    }
+
+    /*
+    ** Write the remaining bands in order, or on failure just wait for
+    ** them so that their buffers can be released.
+    */
+    for (i = 0; i < slots; ++i)
+    {
+        bp = &bands[(slot + i) % slots];
+        if (status == 0)
+            status = FlushBand(bp, ofp);
+        else if (bp->rows > 0)
+            WaitBand(bp);
+    }
+    DestroyTGAPool(pool);
+    for (slot = 0; slot < slots; ++slot)
+    {
+        free(bands[slot].raw);
+        free(bands[slot].packed);
+    }
+    free(bands);
+    thread_cond_destroy(state.cond);
+    thread_mutex_destroy(state.mutex);
+    return status;
+}
+
+/*
+** Estimate the size of the run length encoded image data of a decoder
+** by encoding samples rows spread evenly through the image, or every
+** row if samples is not less than the height, and scaling the result.
+** The rows are read like DecodeTGARegion reads them, so nothing needs
+** to be written and rows decoded with DecodeTGARow are not affected,
+** but a file that cannot seek cannot be sampled.  The flags are those
+** of EncodeTGAImage.  Returns the estimated size in bytes.
+*/
+long EstimateTGAEncodedSize(TGADecoder *dp, int samples, int flags)
+{
+    int (*encode)(char *p, char *q, int n, int bpp);
+    unsigned char *raw;
+    unsigned char *packed;
+    long height;
+    long total = 0;
+    long row;
+    int convertFlags;
+    int bpp;
+    int i;
+
+    if (dp == NULL || dp->sp == NULL)
+    {
+        return TGA_ENCODE_ERROR_NULL_ARGUMENT;
+    }
+    height = dp->sp->imageHeight;
+    if (dp->rowBytes == 0 || height == 0)
+    {
+        return 0;
+    }
+    if (samples < 1 || samples > height)
+    {
+        samples = (int) height;
+    }
+    convertFlags = NarrowFlags(dp, flags);
+    if (convertFlags >= 0 && dp->pixelBytes != 3 && dp->pixelBytes != 4)
+    {
+        return TGA_ENCODE_ERROR_ARGUMENT;
+    }
+    bpp = convertFlags >= 0 ? 2 : dp->pixelBytes;
+    encode = (flags & TGA_ENCODE_OPTIMAL) ? RLEncodeRowOptimal : RLEncodeRow;
+    raw = malloc(dp->rowBytes);
+    packed = malloc((size_t) dp->sp->imageWidth * (bpp + 1));
+    if (raw == NULL || packed == NULL)
+    {
+        free(raw);
+        free(packed);
+        return TGA_ENCODE_ERROR_ALLOCATE;
+    }
+
+    /*
+    ** Each sample is taken from the middle of its share of the rows.
+    */
+    for (i = 0; i < samples; ++i)
+    {
+        row = (long) ((2 * i + 1) * (double) height / (2 * samples));
+        if (DecodeTGARegion(dp, 0, (int) row, dp->sp->imageWidth, 1, raw, 0, 0) < 0)
+        {
+            total = TGA_ENCODE_ERROR_READ;
+            break;
+        }
+        if (convertFlags >= 0)
+            NarrowTGAPixels(raw, raw, dp->sp->imageWidth, dp->pixelBytes, convertFlags, row);
+        total += encode((char *) raw, (char *) packed, dp->sp->imageWidth, bpp);
+    }
+    free(raw);
+    free(packed);
+    if (total < 0)
+    {
+        return total;
+    }
+    return (long) ((double) total * height / samples);
+}
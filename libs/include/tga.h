@@ -110,8 +110,132 @@ typedef struct _TGAFile
         UINT32  extAreaOffset;          /* extension area offset */
         UINT32  devDirOffset;           /* developer directory offset */
         char    signature[18];          /* signature string     */
+        FILE    *source;                /* file holding tables not yet read */
+        const unsigned char *sourceData; /* mapping holding tables not yet read */
+        long    sourceSize;             /* size of mapping in bytes */
 } TGAFile;
 
+/*
+** A read-only view of an entire TGA file mapped into memory.
+*/
+typedef struct _TGAMap
+{
+        const unsigned char *data;      /* start of the file contents */
+        long            size;           /* size of the file in bytes */
+        void            *handle;        /* platform specific mapping handle */
+} TGAMap;
+
+/*
+** State used to decode the image data field of a TGA file.  A decoder
+** owns all of its scratch buffers, so separate decoders may be used to
+** decode separate images concurrently on separate threads.
+*/
+typedef struct _TGADecoder
+{
+        FILE            *fp;            /* input file pointer */
+        TGAFile         *sp;            /* image being decoded */
+        int             bytesPerPixel;  /* bytes per stored pixel */
+        int             pixelBytes;     /* bytes per decoded pixel */
+        int             convertFlags;   /* flags for widening 16 bit pixels */
+        int             rle;            /* non-zero for run length encoded data */
+        const struct _TGAKernels *kernels; /* pixel kernels for this processor */
+        long            rowBytes;       /* bytes per decoded row */
+        long            row;            /* number of rows decoded so far */
+        unsigned char   *inBuf;         /* buffered image data, NULL when mapped */
+        unsigned char   *inPtr;         /* next unread byte of inBuf */
+        unsigned char   *inEnd;         /* end of valid data in inBuf */
+        long            inSize;         /* allocated size of inBuf */
+        int             positioned;     /* non-zero to refill inBuf from inOffset */
+        long            inOffset;       /* file offset of the data following inEnd */
+        int             wrapPackets;    /* non-zero to accept packets crossing rows */
+        long            carry;          /* pixels of a packet left for the next row */
+        int             carryRun;       /* non-zero when the carried packet is a run */
+        unsigned char   carryPixel[4];  /* pixel repeated by a carried run */
+        UINT32          *rowOffsets;    /* index of stored rows built by decoder */
+        UINT32          *colors;        /* color map expanded for decoding, or NULL */
+        UINT32          *correct;       /* color correction of each byte, or NULL */
+        unsigned char   *image;         /* image buffer allocated by decoder */
+} TGADecoder;
+
+/*
+** Flags selecting the layout of the image produced by DecodeTGAImage
+*/
+#define TGA_DECODE_TOP_DOWN     0x01    /* first row is the top of the image */
+#define TGA_DECODE_BOTTOM_UP    0x02    /* first row is the bottom of the image */
+#define TGA_DECODE_LEFT_RIGHT   0x04    /* first pixel is the left of the row */
+
+/*
+** Flags selecting the corrections made by SetTGAColorCorrection
+*/
+#define TGA_CORRECT_TABLE       0x01    /* apply the color correction table */
+#define TGA_CORRECT_GAMMA       0x02    /* apply the gamma value */
+
+/*
+** Flags selecting how EncodeTGAImage encodes each row
+*/
+#define TGA_ENCODE_OPTIMAL      0x01    /* smallest encoding instead of greedy */
+#define TGA_ENCODE_NARROW       0x02    /* encode pixels narrowed to 16 bits */
+#define TGA_ENCODE_DITHER       0x04    /* dither pixels being narrowed */
+
+/*
+** Flags selecting the sections of a file read by ProbeTGAFile, in
+** addition to the header and ID string
+*/
+#define TGA_PROBE_FOOTER        0x01    /* extension and developer offsets */
+#define TGA_PROBE_EXTENSION     0x02    /* extension area, without its tables */
+#define TGA_PROBE_STAMP         0x04    /* postage stamp size */
+#define TGA_PROBE_DEVELOPER     0x08    /* number of developer tags */
+
+/*
+** Suffix appended to an image file name to name its row index file
+*/
+#define TGA_INDEX_SUFFIX        ".idx"
+
+/*
+** A rearrangement of the channels of each pixel.  Byte c of an output
+** pixel is byte map[c] of the input pixel, or the constant value when
+** map[c] is negative.  Pixels of 3 and 4 bytes are handled fastest.
+*/
+typedef struct _TGASwizzle
+{
+        int             srcBpp;         /* bytes per input pixel */
+        int             dstBpp;         /* bytes per output pixel */
+        signed char     map[4];         /* input byte of each output byte */
+        UINT8           constant;       /* value of unmapped output bytes */
+} TGASwizzle;
+
+extern const TGASwizzle TGASwizzleStripAlpha;  /* BGRA to BGR */
+extern const TGASwizzle TGASwizzleAddAlpha;    /* BGR to BGRA, opaque */
+extern const TGASwizzle TGASwizzleSwapRB32;    /* BGRA to RGBA */
+extern const TGASwizzle TGASwizzleSwapRB24;    /* BGR to RGB */
+
+/*
+** Flags for converting between 16 bit pixels and pixels of 8 bits per
+** channel with WidenTGAPixels and NarrowTGAPixels
+*/
+#define TGA_CONVERT_NO_ALPHA    0x01    /* 16 bit pixels have no attribute bit */
+#define TGA_CONVERT_DITHER      0x02    /* dither channels cut to 5 bits */
+
+/*
+** Reduced copies of an image made by CreateTGAPyramid.  Each level is
+** half the width and height of the one above it, rounded up, starting
+** from half the size of the image at level 0.
+*/
+#define TGA_PYRAMID_LEVELS      16
+
+typedef struct _TGAPyramid
+{
+        int             levels;                         /* number of levels built */
+        int             width[TGA_PYRAMID_LEVELS];      /* width of each level */
+        int             height[TGA_PYRAMID_LEVELS];     /* height of each level */
+        unsigned char   *pixels[TGA_PYRAMID_LEVELS];    /* rows of each level */
+} TGAPyramid;
+
+/*
+** Cache of the row offsets of recently decoded image files
+*/
+typedef struct _TGAIndexCache TGAIndexCache;
+
 enum ReadErrors
 {
     TGA_READ_ERROR_NULL_ARGUMENT = -1,
@@ -121,9 +245,64 @@ enum ReadErrors
     TGA_READ_ERROR_BAD_FILE_SIZE = -5,
     TGA_READ_ERROR_READ_EXTENDED = -6,
     TGA_READ_ERROR_READ_DEVELOPER_DIRECTORY = -7,
+    TGA_READ_ERROR_READ_HEADER = -8,
+    TGA_READ_ERROR_MAP = -9,
+};
+
+enum DecodeErrors
+{
+    TGA_DECODE_ERROR_NULL_ARGUMENT = -1,
+    TGA_DECODE_ERROR_IMAGE_TYPE = -2,
+    TGA_DECODE_ERROR_ALLOCATE = -3,
+    TGA_DECODE_ERROR_SEEK = -4,
+    TGA_DECODE_ERROR_READ = -5,
+    TGA_DECODE_ERROR_BAD_PACKET = -6,
+    TGA_DECODE_ERROR_ARGUMENT = -7,
+    TGA_DECODE_ERROR_WRITE = -8,
+};
+
+enum EncodeErrors
+{
+    TGA_ENCODE_ERROR_NULL_ARGUMENT = -1,
+    TGA_ENCODE_ERROR_ALLOCATE = -2,
+    TGA_ENCODE_ERROR_READ = -3,
+    TGA_ENCODE_ERROR_WRITE = -4,
+    TGA_ENCODE_ERROR_ARGUMENT = -5,
+};
+
+enum ConvertErrors
+{
+    TGA_CONVERT_ERROR_NULL_ARGUMENT = -1,
+    TGA_CONVERT_ERROR_BAD_SWIZZLE = -2,
+    TGA_CONVERT_ERROR_BAD_DEPTH = -3,
+};
+
+enum StampErrors
+{
+    TGA_STAMP_ERROR_NULL_ARGUMENT = -1,
+    TGA_STAMP_ERROR_ARGUMENT = -2,
+    TGA_STAMP_ERROR_ALLOCATE = -3,
+    TGA_STAMP_ERROR_READ = -4,
+};
+
+enum IndexErrors
+{
+    TGA_INDEX_ERROR_NULL_ARGUMENT = -1,
+    TGA_INDEX_ERROR_STAT = -2,
+    TGA_INDEX_ERROR_OPEN = -3,
+    TGA_INDEX_ERROR_READ = -4,
+    TGA_INDEX_ERROR_WRITE = -5,
+    TGA_INDEX_ERROR_STALE = -6,
+    TGA_INDEX_ERROR_DECODE = -7,
+    TGA_INDEX_ERROR_ALLOCATE = -8,
 };
 
 int ReadTGAFile(FILE *fp, TGAFile *sp);
+int ProbeTGAFile(FILE *fp, TGAFile *sp, int flags);
+int ReadTGAHeader(FILE *fp, TGAFile *sp);
+const UINT16 *GetTGAColorCorrectTable(TGAFile *sp);
+const UINT32 *GetTGAScanLineTable(TGAFile *sp);
+int ReadTGAMemory(const unsigned char *data, long size, TGAFile *sp);
 UINT32 ReadLong(FILE *fp);
 int ReadRLERow(FILE *fp, unsigned char *p, int n, int bpp);
 
@@ -136,10 +315,48 @@ int WriteTGAFile(TGAFile *sp, FILE *ofp);
 int CopyTGAColormap(TGAFile *sp, FILE *in, FILE *out);
 
 int RLEncodeRow(char *p, char *q, int n, int bpp);
+int RLEncodeRowOptimal(char *p, char *q, int n, int bpp);
 long CountRLEData(FILE *fp, unsigned int x, unsigned int y, int bytesPerPixel);
 
 void FreeTGAFile(TGAFile *sp);
 
+long GetTGADataOffset(TGAFile *sp);
+int InitTGADecoder(TGADecoder *dp, FILE *fp, TGAFile *sp);
+int InitTGAMapDecoder(TGADecoder *dp, TGAMap *mp, TGAFile *sp);
+int DecodeTGARow(TGADecoder *dp, unsigned char *p);
+int DecodeTGAImage(TGADecoder *dp, unsigned char **imagep, long stride, int flags);
+int DecodeTGAImageParallel(TGADecoder *dp, unsigned char **imagep, long stride, int flags, int threads);
+int IndexTGARows(TGADecoder *dp, UINT32 *offsets);
+long CopyTGARows(TGADecoder *dp, FILE *ofp, long base, UINT32 *offsets);
+int DecodeTGARegion(TGADecoder *dp, int x, int y, int w, int h, unsigned char *p, long stride, int flags);
+int GetTGARowOffsets(TGADecoder *dp, const UINT32 **offsetsp);
+int SetTGARowOffsets(TGADecoder *dp, const UINT32 *offsets);
+int ExpandTGAColormap(TGADecoder *dp, const unsigned char *colormap, int bytesPerPixel);
+int SetTGADecodeFormat(TGADecoder *dp, int bytesPerPixel);
+int SetTGAColorCorrection(TGADecoder *dp, int flags);
+void FreeTGADecoder(TGADecoder *dp);
+
+int EncodeTGAImage(TGADecoder *dp, FILE *ofp, int threads, int flags);
+long EstimateTGAEncodedSize(TGADecoder *dp, int samples, int flags);
+
+int CreateTGAStamp(TGADecoder *dp, const unsigned char *colormap, unsigned char *stamp, int w, int h, int threads);
+int CreateTGAPyramid(TGADecoder *dp, const unsigned char *colormap, TGAPyramid *pp, int count);
+void FreeTGAPyramid(TGAPyramid *pp);
+
+int SwizzleTGAPixels(unsigned char *d, const unsigned char *s, long count, const TGASwizzle *sw);
+int WidenTGAPixels(unsigned char *d, const unsigned char *s, long count, int dstBpp, int flags);
+int NarrowTGAPixels(unsigned char *d, const unsigned char *s, long count, int srcBpp, int flags, long row);
+
+int WriteTGAIndex(const char *fileName, TGADecoder *dp);
+int ReadTGAIndex(const char *fileName, TGADecoder *dp);
+TGAIndexCache *CreateTGAIndexCache(int entries);
+int LoadTGAIndex(TGAIndexCache *cache, const char *fileName, TGADecoder *dp);
+void FreeTGAIndexCache(TGAIndexCache *cache);
+
+int MapTGAFile(const char *fileName, TGAMap *mp, TGAFile *sp);
+const unsigned char *GetTGAMappedImage(TGAMap *mp, TGAFile *sp);
+void UnmapTGAFile(TGAMap *mp);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,401 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <tga.h>
+
+#include <config/thread.h>
+
+#define INDEX_MAGIC "TGAINDEX"  /* first bytes of a sidecar index file */
+#define INDEX_VERSION 1         /* version of the sidecar layout */
+#define INDEX_HEADER_SIZE 28    /* size of the sidecar header in bytes */
+
+/*
+** A sidecar index file holds the offset of each stored row of an image,
+** together with the size and modification time of the image file so
+** that an index left behind by an earlier version of the image is never
+** used.  All values are stored little-endian:
+**
+**      0       8 bytes         "TGAINDEX"
+**      8       4 bytes         layout version
+**      12      4 bytes         size of the image file
+**      16      8 bytes         modification time of the image file
+**      24      4 bytes         number of rows
+**      28      4 bytes each    offset of each stored row
+*/
+
+typedef struct _TGAIndexEntry
+{
+    char *path;          /* image file name */
+    long size;           /* size of the image file */
+    time_t mtime;        /* modification time of the image file */
+    long rows;           /* number of entries in offsets */
+    UINT32 *offsets;     /* offset of each stored row */
+    unsigned long used;  /* time of last use, for eviction */
+} TGAIndexEntry;
+
+struct _TGAIndexCache
+{
+    thread_mutex mutex;
+    TGAIndexEntry *entries;
+    int capacity;
+    int count;
+    unsigned long clock;
+};
+
+static void PutLong(unsigned char *p, UINT32 v)
+{
+    p[0] = (unsigned char) v;
+    p[1] = (unsigned char) (v >> 8);
+    p[2] = (unsigned char) (v >> 16);
+    p[3] = (unsigned char) (v >> 24);
+}
+
+static UINT32 GetLong(const unsigned char *p)
+{
+    return (UINT32) p[0] | ((UINT32) p[1] << 8) | ((UINT32) p[2] << 16) | ((UINT32) p[3] << 24);
+}
+
+/*
+** Find the size and modification time that identify a version of the
+** image file.
+*/
+static int GetFileKey(const char *fileName, long *sizep, time_t *mtimep)
+{
+    struct stat st;
+
+    if (stat(fileName, &st) != 0)
+    {
+        return TGA_INDEX_ERROR_STAT;
+    }
+    *sizep = (long) st.st_size;
+    *mtimep = st.st_mtime;
+    return 0;
+}
+
+static char *GetSidecarName(const char *fileName)
+{
+    char *name;
+
+    name = malloc(strlen(fileName) + sizeof(TGA_INDEX_SUFFIX));
+    if (name != NULL)
+    {
+        strcpy(name, fileName);
+        strcat(name, TGA_INDEX_SUFFIX);
+    }
+    return name;
+}
+
+static void PutHeader(unsigned char *p, long size, time_t mtime, long rows)
+{
+    long long t = (long long) mtime;
+
+    memcpy(p, INDEX_MAGIC, 8);
+    PutLong(p + 8, INDEX_VERSION);
+    PutLong(p + 12, (UINT32) size);
+    PutLong(p + 16, (UINT32) (t & 0xffffffffL));
+    PutLong(p + 20, (UINT32) ((unsigned long long) t >> 32));
+    PutLong(p + 24, (UINT32) rows);
+}
+
+/*
+** Write a sidecar index for the image file fileName decoded by dp, using
+** the scan line table or an index of the rows built by the decoder.
+*/
+int WriteTGAIndex(const char *fileName, TGADecoder *dp)
+{
+    unsigned char header[INDEX_HEADER_SIZE];
+    unsigned char entry[4];
+    const UINT32 *offsets;
+    char *name;
+    FILE *fp;
+    long size;
+    long row;
+    time_t mtime;
+    int status;
+
+    if (fileName == NULL || dp == NULL || dp->sp == NULL)
+    {
+        return TGA_INDEX_ERROR_NULL_ARGUMENT;
+    }
+    status = GetFileKey(fileName, &size, &mtime);
+    if (status < 0)
+    {
+        return status;
+    }
+    if (GetTGARowOffsets(dp, &offsets) < 0)
+    {
+        return TGA_INDEX_ERROR_DECODE;
+    }
+    name = GetSidecarName(fileName);
+    if (name == NULL)
+    {
+        return TGA_INDEX_ERROR_ALLOCATE;
+    }
+    fp = fopen(name, "wb");
+    if (fp == NULL)
+    {
+        free(name);
+        return TGA_INDEX_ERROR_OPEN;
+    }
+    PutHeader(header, size, mtime, dp->sp->imageHeight);
+    status = fwrite(header, 1, INDEX_HEADER_SIZE, fp) == INDEX_HEADER_SIZE ? 0 : TGA_INDEX_ERROR_WRITE;
+    for (row = 0; row < dp->sp->imageHeight && status == 0; ++row)
+    {
+        PutLong(entry, offsets[row]);
+        if (fwrite(entry, 1, 4, fp) != 4)
+            status = TGA_INDEX_ERROR_WRITE;
+    }
+    if (fclose(fp) != 0 && status == 0)
+    {
+        status = TGA_INDEX_ERROR_WRITE;
+    }
+    if (status < 0)
+    {
+        remove(name);
+    }
+    free(name);
+    return status;
+}
+
+/*
+** Read the offsets of the sidecar index of fileName into a new array,
+** provided the index matches the current version of the image file.
+*/
+static int LoadSidecar(const char *fileName, long size, time_t mtime, long rows, UINT32 **offsetsp)
+{
+    unsigned char expect[INDEX_HEADER_SIZE];
+    unsigned char header[INDEX_HEADER_SIZE];
+    unsigned char *data;
+    UINT32 *offsets;
+    char *name;
+    FILE *fp;
+    long row;
+    int status = 0;
+
+    name = GetSidecarName(fileName);
+    if (name == NULL)
+    {
+        return TGA_INDEX_ERROR_ALLOCATE;
+    }
+    fp = fopen(name, "rb");
+    free(name);
+    if (fp == NULL)
+    {
+        return TGA_INDEX_ERROR_OPEN;
+    }
+    PutHeader(expect, size, mtime, rows);
+    data = malloc(rows * 4 + 1);
+    offsets = malloc(rows * sizeof(UINT32) + 1);
+    if (data == NULL || offsets == NULL)
+    {
+        status = TGA_INDEX_ERROR_ALLOCATE;
+    }
+    else if (fread(header, 1, INDEX_HEADER_SIZE, fp) != INDEX_HEADER_SIZE ||
+             fread(data, 4, rows, fp) != (size_t) rows)
+    {
+        status = TGA_INDEX_ERROR_READ;
+    }
+    else if (memcmp(header, expect, INDEX_HEADER_SIZE) != 0)
+    {
+        status = TGA_INDEX_ERROR_STALE;
+    }
+    fclose(fp);
+    if (status == 0)
+    {
+        for (row = 0; row < rows; ++row)
+        {
+            offsets[row] = GetLong(data + row * 4);
+        }
+        *offsetsp = offsets;
+        offsets = NULL;
+    }
+    free(data);
+    free(offsets);
+    return status;
+}
+
+/*
+** Give the decoder the row offsets from the sidecar index of fileName.
+** Fails with TGA_INDEX_ERROR_STALE when the image file has changed since
+** the index was written.
+*/
+int ReadTGAIndex(const char *fileName, TGADecoder *dp)
+{
+    UINT32 *offsets;
+    long size;
+    time_t mtime;
+    int status;
+
+    if (fileName == NULL || dp == NULL || dp->sp == NULL)
+    {
+        return TGA_INDEX_ERROR_NULL_ARGUMENT;
+    }
+    status = GetFileKey(fileName, &size, &mtime);
+    if (status == 0)
+    {
+        status = LoadSidecar(fileName, size, mtime, dp->sp->imageHeight, &offsets);
+    }
+    if (status == 0)
+    {
+        if (SetTGARowOffsets(dp, offsets) < 0)
+            status = TGA_INDEX_ERROR_STALE;
+        free(offsets);
+    }
+    return status;
+}
+
+/*
+** Create a cache of the row offsets of up to entries image files, which
+** may be shared by threads decoding different files.
+*/
+TGAIndexCache *CreateTGAIndexCache(int entries)
+{
+    TGAIndexCache *cache;
+
+    if (entries < 1)
+    {
+        return NULL;
+    }
+    cache = calloc(1, sizeof(TGAIndexCache));
+    if (cache == NULL)
+    {
+        return NULL;
+    }
+    cache->entries = calloc(entries, sizeof(TGAIndexEntry));
+    if (cache->entries == NULL || thread_mutex_create(&cache->mutex) < 0)
+    {
+        free(cache->entries);
+        free(cache);
+        return NULL;
+    }
+    cache->capacity = entries;
+    return cache;
+}
+
+static void ClearEntry(TGAIndexEntry *ep)
+{
+    free(ep->path);
+    free(ep->offsets);
+    memset(ep, 0, sizeof(TGAIndexEntry));
+}
+
+/*
+** Give the decoder the row offsets of fileName, from the cache when it
+** holds them for the current version of the file, otherwise from the
+** sidecar index, and otherwise by indexing the image data.  Offsets not
+** found in the cache are added to it, replacing the least recently used
+** entry when the cache is full.
+*/
+int LoadTGAIndex(TGAIndexCache *cache, const char *fileName, TGADecoder *dp)
+{
+    TGAIndexEntry *ep;
+    const UINT32 *found;
+    UINT32 *offsets = NULL;
+    size_t bytes;
+    long size;
+    long rows;
+    time_t mtime;
+    int status;
+    int i;
+
+    if (cache == NULL || fileName == NULL || dp == NULL || dp->sp == NULL)
+    {
+        return TGA_INDEX_ERROR_NULL_ARGUMENT;
+    }
+    status = GetFileKey(fileName, &size, &mtime);
+    if (status < 0)
+    {
+        return status;
+    }
+    rows = dp->sp->imageHeight;
+
+    thread_mutex_lock(cache->mutex);
+    for (i = 0; i < cache->count; ++i)
+    {
+        ep = &cache->entries[i];
+        if (ep->size == size && ep->mtime == mtime && ep->rows == rows && strcmp(ep->path, fileName) == 0)
+        {
+            ep->used = ++cache->clock;
+            status = SetTGARowOffsets(dp, ep->offsets) < 0 ? TGA_INDEX_ERROR_STALE : 0;
+            thread_mutex_unlock(cache->mutex);
+            return status;
+        }
+    }
+    thread_mutex_unlock(cache->mutex);
+
+    /*
+    ** Build the offsets without holding the lock, since indexing may
+    ** have to read the whole image.
+    */
+    if (LoadSidecar(fileName, size, mtime, rows, &offsets) == 0 && SetTGARowOffsets(dp, offsets) == 0)
+    {
+        found = dp->rowOffsets;
+    }
+    else if (GetTGARowOffsets(dp, &found) < 0)
+    {
+        free(offsets);
+        return TGA_INDEX_ERROR_DECODE;
+    }
+    free(offsets);
+
+    bytes = rows * sizeof(UINT32);
+    offsets = malloc(bytes + 1);
+    if (offsets == NULL)
+    {
+        return 0;
+    }
+    memcpy(offsets, found, bytes);
+
+    thread_mutex_lock(cache->mutex);
+    if (cache->count < cache->capacity)
+    {
+        ep = &cache->entries[cache->count++];
+    }
+    else
+    {
+        ep = &cache->entries[0];
+        for (i = 1; i < cache->count; ++i)
+        {
+            if (cache->entries[i].used < ep->used)
+                ep = &cache->entries[i];
+        }
+        ClearEntry(ep);
+    }
+    ep->path = malloc(strlen(fileName) + 1);
+    if (ep->path == NULL)
+    {
+        free(offsets);
+        *ep = cache->entries[--cache->count];
+        memset(&cache->entries[cache->count], 0, sizeof(TGAIndexEntry));
+    }
+    else
+    {
+        strcpy(ep->path, fileName);
+        ep->size = size;
+        ep->mtime = mtime;
+        ep->rows = rows;
+        ep->offsets = offsets;
+        ep->used = ++cache->clock;
+    }
+    thread_mutex_unlock(cache->mutex);
+    return 0;
+}
+
+void FreeTGAIndexCache(TGAIndexCache *cache)
+{
+    int i;
+
+    if (cache == NULL)
+    {
+        return;
+    }
+    for (i = 0; i < cache->count; ++i)
+    {
+        ClearEntry(&cache->entries[i]);
+    }
+    free(cache->entries);
+    thread_mutex_destroy(cache->mutex);
+    free(cache);
+}
@@ -0,0 +1,874 @@
+#include <string.h>
+#include <tga.h>
+
+#include "kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define TGA_X86 1
+#endif
+
+#if defined(TGA_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define TGA_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(TGA_X86) && (defined(__GNUC__) || defined(_MSC_VER))
+#define TGA_AVX2 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#if (defined(__ARM_NEON) && defined(__aarch64__)) || defined(_M_ARM64)
+#define TGA_NEON 1
+#include <arm_neon.h>
+#endif
+
+/*
+** The vector kernels replicate a pixel into a pattern whose length is a
+** multiple of every pixel size and of the vector size, so the pattern
+** can be stored repeatedly without regard to pixel boundaries.
+*/
+#define PATTERN_SIZE 96 /* multiple of 1, 2, 3, 4, 16 and 32 */
+
+static void MakePattern(unsigned char *pat, const unsigned char *pixel, int bpp, int size)
+{
+    int i;
+
+    switch (bpp)
+    {
+    case 1:
+        memset(pat, pixel[0], size);
+        break;
+    case 2:
+        for (i = 0; i < size; i += 2)
+            memcpy(pat + i, pixel, 2);
+        break;
+    case 3:
+        for (i = 0; i < size; i += 3)
+            memcpy(pat + i, pixel, 3);
+        break;
+    default:
+        for (i = 0; i < size; i += 4)
+            memcpy(pat + i, pixel, 4);
+        break;
+    }
+}
+
+/*
+** Store the first pixel, then repeatedly double the filled area.
+*/
+static void FillScalar(unsigned char *p, const unsigned char *pixel, int bpp, long count)
+{
+    long total = count * bpp;
+    long filled;
+    long n;
+
+    if (count <= 0)
+        return;
+    if (bpp == 1)
+    {
+        memset(p, pixel[0], count);
+        return;
+    }
+    memcpy(p, pixel, bpp);
+    for (filled = bpp; filled < total; filled += n)
+    {
+        n = filled < total - filled ? filled : total - filled;
+        memcpy(p + filled, p, n);
+    }
+}
+
+static int SamePixel(const unsigned char *a, const unsigned char *b, int bpp)
+{
+    switch (bpp)
+    {
+    case 1:
+        return a[0] == b[0];
+    case 2:
+        return a[0] == b[0] && a[1] == b[1];
+    case 3:
+        return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+    default:
+        return a[0] == b[0] && a[1] == b[1] && a[2] == b[2] && a[3] == b[3];
+    }
+}
+
+static long ScanScalar(const unsigned char *p, int bpp, long count, int equal)
+{
+    long i;
+
+    for (i = 0; i + 1 < count; ++i, p += bpp)
+    {
+        if (SamePixel(p, p + bpp, bpp) == equal)
+            return i;
+    }
+    return count > 0 ? count - 1 : 0;
+}
+
+#if defined(TGA_SSE2) || defined(TGA_AVX2)
+/*
+** The x86 scan kernels compare the bytes of each pixel with the bytes
+** of the following pixel, then combine the byte mask so that the bit of
+** the first byte of each pixel is set only when the whole pixel matches.
+** These masks select the first byte of each complete pixel in a vector.
+*/
+static const unsigned int pairMask16[5] = {0, 0xffff, 0x5555, 0x1249, 0x1111};
+static const unsigned int pairMask32[5] = {0, 0xffffffff, 0x55555555, 0x09249249, 0x11111111};
+
+static unsigned int PixelMask(unsigned int m, int bpp)
+{
+    unsigned int e = m;
+
+    if (bpp > 1)
+        e &= m >> 1;
+    if (bpp > 2)
+        e &= m >> 2;
+    if (bpp > 3)
+        e &= m >> 3;
+    return e;
+}
+
+static int LowestBit(unsigned int m)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+
+    _BitScanForward(&index, m);
+    return (int) index;
+#else
+    return __builtin_ctz(m);
+#endif
+}
+#endif
+
+#if defined(TGA_SSE2) || defined(TGA_AVX2)
+/*
+** Spread the dither values of successive pixels over the color bytes of
+** size bytes of 4 byte pixels, for adding to the pixels with saturation.
+*/
+static void MakeDither(unsigned char *t, const unsigned char *dither, int size)
+{
+    int i;
+
+    for (i = 0; i < size; ++i)
+        t[i] = dither != NULL && (i & 3) != 3 ? dither[(i >> 2) & 3] : 0;
+}
+#endif
+
+static void SwizzleScalar(unsigned char *d, const unsigned char *s, long count, const TGASwizzle *sw)
+{
+    unsigned char pixel[4];
+    int c;
+
+    /*
+    ** Each pixel is copied aside first so that the channels of a pixel
+    ** may be rearranged in place.
+    */
+    for (; count > 0; --count, s += sw->srcBpp, d += sw->dstBpp)
+    {
+        memcpy(pixel, s, sw->srcBpp);
+        for (c = 0; c < sw->dstBpp; ++c)
+        {
+            d[c] = sw->map[c] < 0 ? sw->constant : pixel[sw->map[c]];
+        }
+    }
+}
+
+/*
+** The entries of colors hold the bytes of each color in memory order,
+** so the first three bytes of an entry are a 3 byte pixel.
+*/
+static void ExpandScalar(unsigned char *d, const unsigned char *s, long count, int bpp, const UINT32 *colors, int dstBpp)
+{
+    unsigned int index;
+
+    for (; count > 0; --count, s += bpp, d += dstBpp)
+    {
+        index = bpp == 1 ? s[0] : s[0] | (s[1] << 8);
+        if (dstBpp == 4)
+            memcpy(d, &colors[index], 4);
+        else
+            memcpy(d, &colors[index], 3);
+    }
+}
+
+/*
+** A 16 bit pixel holds 5 bits each of blue, green and red, from the low
+** bit up, and an attribute bit taken as alpha.  Each 5 bit channel is
+** widened by repeating its top bits below it, so 0 and 31 become 0 and
+** 255.
+*/
+static void WidenScalar(unsigned char *d, const unsigned char *s, long count, int dstBpp, int flags)
+{
+    unsigned int v;
+    int c;
+
+    for (; count > 0; --count, s += 2, d += dstBpp)
+    {
+        v = s[0] | (s[1] << 8);
+        if (dstBpp == 4)
+            d[3] = (flags & TGA_CONVERT_NO_ALPHA) || (v & 0x8000) ? 0xff : 0;
+        for (c = 0; c < 3; ++c, v >>= 5)
+            d[c] = (unsigned char) (((v & 0x1f) << 3) | ((v & 0x1f) >> 2));
+    }
+}
+
+/*
+** The attribute bit is set from alpha of at least 128, and always set
+** for 3 byte pixels.  Each pixel is read before its result is stored,
+** so the pixels may be narrowed in place.
+*/
+static void NarrowScalar(unsigned char *d, const unsigned char *s, long count, int srcBpp, int flags, const unsigned char *dither)
+{
+    unsigned int v;
+    unsigned int t;
+    unsigned int a;
+    long i;
+    int c;
+
+    for (i = 0; i < count; ++i, s += srcBpp, d += 2)
+    {
+        t = dither != NULL ? dither[i & 3] : 0;
+        a = flags & TGA_CONVERT_NO_ALPHA ? 0 : srcBpp == 3 || s[3] >= 128;
+        v = a << 15;
+        for (c = 0; c < 3; ++c)
+            v |= (s[c] + t > 255 ? 31 : (s[c] + t) >> 3) << (5 * c);
+        d[0] = (unsigned char) v;
+        d[1] = (unsigned char) (v >> 8);
+    }
+}
+
+static void LookupScalar(unsigned char *d, const unsigned char *s, long count, int bpp, const UINT32 *tables)
+{
+    const unsigned char *t = (const unsigned char *) tables;
+    int c;
+
+    for (; count > 0; --count, s += bpp, d += bpp)
+    {
+        for (c = 0; c < bpp; ++c)
+            d[c] = t[4 * (c * 256 + s[c]) + c];
+    }
+}
+
+#if defined(TGA_AVX2)
+/*
+** Build the byte shuffle that applies a swizzle to the four pixels held
+** in 16 bytes, along with the constant bytes to be merged into the
+** result, for 3 and 4 byte pixels.
+*/
+static void MakeShuffle(unsigned char *shuffle, unsigned char *constant, const TGASwizzle *sw)
+{
+    int k;
+    int c;
+
+    memset(shuffle, 0x80, 16);
+    memset(constant, 0, 16);
+    for (k = 0; k < 4; ++k)
+    {
+        for (c = 0; c < sw->dstBpp; ++c)
+        {
+            if (sw->map[c] < 0)
+                constant[k * sw->dstBpp + c] = sw->constant;
+            else
+                shuffle[k * sw->dstBpp + c] = (unsigned char) (k * sw->srcBpp + sw->map[c]);
+        }
+    }
+}
+#endif
+
+static const TGAKernels scalarKernels =
+{
+    "scalar",
+    FillScalar,
+    ScanScalar,
+    SwizzleScalar,
+    ExpandScalar,
+    WidenScalar,
+    NarrowScalar,
+    LookupScalar,
+};
+
+#ifdef TGA_SSE2
+static void FillSSE2(unsigned char *p, const unsigned char *pixel, int bpp, long count)
+{
+    unsigned char pat[48];
+    long n = count * bpp;
+    __m128i v0;
+    __m128i v1;
+    __m128i v2;
+
+    if (bpp == 1 || n < 32)
+    {
+        FillScalar(p, pixel, bpp, count);
+        return;
+    }
+    MakePattern(pat, pixel, bpp, 48);
+    v0 = _mm_loadu_si128((const __m128i *) pat);
+    v1 = _mm_loadu_si128((const __m128i *) (pat + 16));
+    v2 = _mm_loadu_si128((const __m128i *) (pat + 32));
+    for (; n >= 48; n -= 48, p += 48)
+    {
+        _mm_storeu_si128((__m128i *) p, v0);
+        _mm_storeu_si128((__m128i *) (p + 16), v1);
+        _mm_storeu_si128((__m128i *) (p + 32), v2);
+    }
+    memcpy(p, pat, n);
+}
+
+static long ScanSSE2(const unsigned char *p, int bpp, long count, int equal)
+{
+    long pairs = 16 / bpp;
+    long i = 0;
+    unsigned int e;
+    __m128i a;
+    __m128i b;
+
+    /* both vectors must lie within the count pixels */
+    for (; (i + 1) * bpp + 16 <= count * bpp; i += pairs)
+    {
+        a = _mm_loadu_si128((const __m128i *) (p + i * bpp));
+        b = _mm_loadu_si128((const __m128i *) (p + (i + 1) * bpp));
+        e = PixelMask((unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)), bpp);
+        if (!equal)
+            e = ~e;
+        e &= pairMask16[bpp];
+        if (e != 0)
+            return i + LowestBit(e) / bpp;
+    }
+    return i + ScanScalar(p + i * bpp, bpp, count - i, equal);
+}
+
+/*
+** The 16 bit pixels are widened to 32 bits, and each channel is shifted
+** to the top of its byte, then its top bits are repeated below it.
+*/
+static void WidenSSE2(unsigned char *d, const unsigned char *s, long count, int dstBpp, int flags)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i alpha = _mm_set1_epi32((int) 0xff000000);
+    __m128i w;
+    __m128i x;
+
+    if (dstBpp != 4)
+    {
+        WidenScalar(d, s, count, dstBpp, flags);
+        return;
+    }
+    for (; count >= 4; count -= 4, s += 8, d += 16)
+    {
+        w = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *) s), zero);
+        x = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(w, _mm_set1_epi32(0x001f)), 3),
+                         _mm_slli_epi32(_mm_and_si128(w, _mm_set1_epi32(0x03e0)), 6));
+        x = _mm_or_si128(x, _mm_slli_epi32(_mm_and_si128(w, _mm_set1_epi32(0x7c00)), 9));
+        x = _mm_or_si128(x, _mm_and_si128(_mm_srli_epi32(x, 5), _mm_set1_epi32(0x070707)));
+        if (flags & TGA_CONVERT_NO_ALPHA)
+            x = _mm_or_si128(x, alpha);
+        else
+            x = _mm_or_si128(x, _mm_and_si128(_mm_srai_epi32(_mm_slli_epi32(w, 16), 31), alpha));
+        _mm_storeu_si128((__m128i *) d, x);
+    }
+    WidenScalar(d, s, count, dstBpp, flags);
+}
+
+/*
+** Saturating addition of the dither values caps each channel at 255,
+** which is 31 once cut to 5 bits.  SSE2 packs 32 bit lanes to 16 bits
+** only with signed saturation, so the lanes are biased around it.
+*/
+static void NarrowSSE2(unsigned char *d, const unsigned char *s, long count, int srcBpp, int flags, const unsigned char *dither)
+{
+    unsigned char t[16];
+    __m128i bias = _mm_set1_epi32(0x8000);
+    __m128i k;
+    __m128i x;
+    __m128i v;
+
+    if (srcBpp != 4)
+    {
+        NarrowScalar(d, s, count, srcBpp, flags, dither);
+        return;
+    }
+    MakeDither(t, dither, 16);
+    k = _mm_loadu_si128((const __m128i *) t);
+    for (; count >= 4; count -= 4, s += 16, d += 8)
+    {
+        x = _mm_adds_epu8(_mm_loadu_si128((const __m128i *) s), k);
+        v = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(x, 3), _mm_set1_epi32(0x001f)),
+                         _mm_and_si128(_mm_srli_epi32(x, 6), _mm_set1_epi32(0x03e0)));
+        v = _mm_or_si128(v, _mm_and_si128(_mm_srli_epi32(x, 9), _mm_set1_epi32(0x7c00)));
+        if (!(flags & TGA_CONVERT_NO_ALPHA))
+            v = _mm_or_si128(v, _mm_and_si128(_mm_srli_epi32(x, 16), bias));
+        v = _mm_sub_epi32(v, bias);
+        v = _mm_add_epi16(_mm_packs_epi32(v, v), _mm_set1_epi16((short) 0x8000));
+        _mm_storel_epi64((__m128i *) d, v);
+    }
+    NarrowScalar(d, s, count, srcBpp, flags, dither);
+}
+
+static const TGAKernels sse2Kernels =
+{
+    "SSE2",
+    FillSSE2,
+    ScanSSE2,
+    SwizzleScalar, /* byte shuffles need SSSE3 */
+    ExpandScalar,  /* gathers need AVX2 */
+    WidenSSE2,
+    NarrowSSE2,
+    LookupScalar, /* gathers need AVX2 */
+};
+#endif
+
+#ifdef TGA_AVX2
+TARGET_AVX2 static void FillAVX2(unsigned char *p, const unsigned char *pixel, int bpp, long count)
+{
+    unsigned char pat[PATTERN_SIZE];
+    long n = count * bpp;
+    __m256i v0;
+    __m256i v1;
+    __m256i v2;
+
+    if (bpp == 1 || n < 64)
+    {
+        FillScalar(p, pixel, bpp, count);
+        return;
+    }
+    MakePattern(pat, pixel, bpp, PATTERN_SIZE);
+    v0 = _mm256_loadu_si256((const __m256i *) pat);
+    v1 = _mm256_loadu_si256((const __m256i *) (pat + 32));
+    v2 = _mm256_loadu_si256((const __m256i *) (pat + 64));
+    for (; n >= PATTERN_SIZE; n -= PATTERN_SIZE, p += PATTERN_SIZE)
+    {
+        _mm256_storeu_si256((__m256i *) p, v0);
+        _mm256_storeu_si256((__m256i *) (p + 32), v1);
+        _mm256_storeu_si256((__m256i *) (p + 64), v2);
+    }
+    memcpy(p, pat, n);
+}
+
+TARGET_AVX2 static long ScanAVX2(const unsigned char *p, int bpp, long count, int equal)
+{
+    long pairs = 32 / bpp;
+    long i = 0;
+    unsigned int e;
+    __m256i a;
+    __m256i b;
+
+    for (; (i + 1) * bpp + 32 <= count * bpp; i += pairs)
+    {
+        a = _mm256_loadu_si256((const __m256i *) (p + i * bpp));
+        b = _mm256_loadu_si256((const __m256i *) (p + (i + 1) * bpp));
+        e = PixelMask((unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)), bpp);
+        if (!equal)
+            e = ~e;
+        e &= pairMask32[bpp];
+        if (e != 0)
+            return i + LowestBit(e) / bpp;
+    }
+    return i + ScanScalar(p + i * bpp, bpp, count - i, equal);
+}
+
+TARGET_AVX2 static void SwizzleAVX2(unsigned char *d, const unsigned char *s, long count, const TGASwizzle *sw)
+{
+    unsigned char shuffle[16];
+    unsigned char constant[16];
+    int sb = sw->srcBpp;
+    int db = sw->dstBpp;
+    __m256i c;
+    __m256i k;
+    __m256i pack;
+    __m256i v;
+
+    if ((sb != 3 && sb != 4) || (db != 3 && db != 4))
+    {
+        SwizzleScalar(d, s, count, sw);
+        return;
+    }
+    MakeShuffle(shuffle, constant, sw);
+    c = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) shuffle));
+    k = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) constant));
+    pack = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    /*
+    ** Each lane holds four pixels.  The second lane of 3 byte pixels is
+    ** loaded from 12 bytes in, so the last load reads 4 bytes beyond the
+    ** eighth pixel; 3 byte results are packed together before storing.
+    */
+    while (count >= (sb == 3 ? 10 : 8))
+    {
+        v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) s)),
+                                    _mm_loadu_si128((const __m128i *) (s + 4 * sb)), 1);
+        v = _mm256_or_si256(_mm256_shuffle_epi8(v, c), k);
+        if (db == 4)
+        {
+            _mm256_storeu_si256((__m256i *) d, v);
+        }
+        else
+        {
+            v = _mm256_permutevar8x32_epi32(v, pack);
+            _mm_storeu_si128((__m128i *) d, _mm256_castsi256_si128(v));
+            _mm_storel_epi64((__m128i *) (d + 16), _mm256_extracti128_si256(v, 1));
+        }
+        s += 8 * sb;
+        d += 8 * db;
+        count -= 8;
+    }
+    SwizzleScalar(d, s, count, sw);
+}
+
+TARGET_AVX2 static void ExpandAVX2(unsigned char *d, const unsigned char *s, long count, int bpp, const UINT32 *colors, int dstBpp)
+{
+    __m256i c;
+    __m256i pack;
+    __m256i index;
+    __m256i v;
+
+    c = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                         0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    pack = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    /*
+    ** Eight indices are widened to 32 bits and their colors gathered in
+    ** one instruction; 3 byte results are packed together before storing.
+    */
+    for (; count >= 8; count -= 8, s += 8 * bpp, d += 8 * dstBpp)
+    {
+        if (bpp == 1)
+            index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) s));
+        else
+            index = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) s));
+        v = _mm256_i32gather_epi32((const int *) colors, index, 4);
+        if (dstBpp == 4)
+        {
+            _mm256_storeu_si256((__m256i *) d, v);
+        }
+        else
+        {
+            v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, c), pack);
+            _mm_storeu_si128((__m128i *) d, _mm256_castsi256_si128(v));
+            _mm_storel_epi64((__m128i *) (d + 16), _mm256_extracti128_si256(v, 1));
+        }
+    }
+    ExpandScalar(d, s, count, bpp, colors, dstBpp);
+}
+
+TARGET_AVX2 static void WidenAVX2(unsigned char *d, const unsigned char *s, long count, int dstBpp, int flags)
+{
+    __m256i alpha = _mm256_set1_epi32((int) 0xff000000);
+    __m256i c;
+    __m256i pack;
+    __m256i w;
+    __m256i x;
+
+    c = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                         0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    pack = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    for (; count >= 8; count -= 8, s += 16, d += 8 * dstBpp)
+    {
+        w = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) s));
+        x = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(w, _mm256_set1_epi32(0x001f)), 3),
+                            _mm256_slli_epi32(_mm256_and_si256(w, _mm256_set1_epi32(0x03e0)), 6));
+        x = _mm256_or_si256(x, _mm256_slli_epi32(_mm256_and_si256(w, _mm256_set1_epi32(0x7c00)), 9));
+        x = _mm256_or_si256(x, _mm256_and_si256(_mm256_srli_epi32(x, 5), _mm256_set1_epi32(0x070707)));
+        if (dstBpp == 4)
+        {
+            if (flags & TGA_CONVERT_NO_ALPHA)
+                x = _mm256_or_si256(x, alpha);
+            else
+                x = _mm256_or_si256(x, _mm256_and_si256(_mm256_srai_epi32(_mm256_slli_epi32(w, 16), 31), alpha));
+            _mm256_storeu_si256((__m256i *) d, x);
+        }
+        else
+        {
+            x = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(x, c), pack);
+            _mm_storeu_si128((__m128i *) d, _mm256_castsi256_si128(x));
+            _mm_storel_epi64((__m128i *) (d + 16), _mm256_extracti128_si256(x, 1));
+        }
+    }
+    WidenScalar(d, s, count, dstBpp, flags);
+}
+
+TARGET_AVX2 static void NarrowAVX2(unsigned char *d, const unsigned char *s, long count, int srcBpp, int flags, const unsigned char *dither)
+{
+    unsigned char t[32];
+    __m256i bit = _mm256_set1_epi32(0x8000);
+    __m256i spread;
+    __m256i k;
+    __m256i x;
+    __m256i v;
+
+    MakeDither(t, dither, 32);
+    k = _mm256_loadu_si256((const __m256i *) t);
+    spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                              0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+
+    /*
+    ** 3 byte pixels are loaded four to a lane as for swizzling, and are
+    ** spread out to 4 bytes; the results are packed to 16 bits and the
+    ** two lanes joined.  Each store ends before the next load starts.
+    */
+    while (count >= (srcBpp == 3 ? 10 : 8))
+    {
+        if (srcBpp == 4)
+        {
+            x = _mm256_loadu_si256((const __m256i *) s);
+        }
+        else
+        {
+            x = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) s)),
+                                        _mm_loadu_si128((const __m128i *) (s + 12)), 1);
+            x = _mm256_shuffle_epi8(x, spread);
+        }
+        x = _mm256_adds_epu8(x, k);
+        v = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(x, 3), _mm256_set1_epi32(0x001f)),
+                            _mm256_and_si256(_mm256_srli_epi32(x, 6), _mm256_set1_epi32(0x03e0)));
+        v = _mm256_or_si256(v, _mm256_and_si256(_mm256_srli_epi32(x, 9), _mm256_set1_epi32(0x7c00)));
+        if (!(flags & TGA_CONVERT_NO_ALPHA))
+            v = _mm256_or_si256(v, srcBpp == 3 ? bit : _mm256_and_si256(_mm256_srli_epi32(x, 16), bit));
+        v = _mm256_permute4x64_epi64(_mm256_packus_epi32(v, v), 0x08);
+        _mm_storeu_si128((__m128i *) d, _mm256_castsi256_si128(v));
+        s += 8 * srcBpp;
+        d += 16;
+        count -= 8;
+    }
+    NarrowScalar(d, s, count, srcBpp, flags, dither);
+}
+
+TARGET_AVX2 static void LookupAVX2(unsigned char *d, const unsigned char *s, long count, int bpp, const UINT32 *tables)
+{
+    __m256i mask = _mm256_set1_epi32(0xff);
+    __m256i spread;
+    __m256i c;
+    __m256i pack;
+    __m256i x;
+    __m256i v;
+
+    spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                              0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    c = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                         0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    pack = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    /*
+    ** Each byte of eight pixels is looked up with one gather, and the
+    ** entries combined.  3 byte pixels are loaded and stored as they are
+    ** for narrowing and expanding, so every load precedes the stores
+    ** that overlap it.
+    */
+    while (count >= (bpp == 3 ? 10 : 8))
+    {
+        if (bpp == 4)
+        {
+            x = _mm256_loadu_si256((const __m256i *) s);
+        }
+        else
+        {
+            x = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) s)),
+                                        _mm_loadu_si128((const __m128i *) (s + 12)), 1);
+            x = _mm256_shuffle_epi8(x, spread);
+        }
+        v = _mm256_i32gather_epi32((const int *) tables, _mm256_and_si256(x, mask), 4);
+        v = _mm256_or_si256(v, _mm256_i32gather_epi32((const int *) (tables + 256),
+                                                      _mm256_and_si256(_mm256_srli_epi32(x, 8), mask), 4));
+        v = _mm256_or_si256(v, _mm256_i32gather_epi32((const int *) (tables + 512),
+                                                      _mm256_and_si256(_mm256_srli_epi32(x, 16), mask), 4));
+        if (bpp == 4)
+        {
+            v = _mm256_or_si256(v, _mm256_i32gather_epi32((const int *) (tables + 768),
+                                                          _mm256_srli_epi32(x, 24), 4));
+            _mm256_storeu_si256((__m256i *) d, v);
+        }
+        else
+        {
+            v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, c), pack);
+            _mm_storeu_si128((__m128i *) d, _mm256_castsi256_si128(v));
+            _mm_storel_epi64((__m128i *) (d + 16), _mm256_extracti128_si256(v, 1));
+        }
+        s += 8 * bpp;
+        d += 8 * bpp;
+        count -= 8;
+    }
+    LookupScalar(d, s, count, bpp, tables);
+}
+
+static const TGAKernels avx2Kernels =
+{
+    "AVX2",
+    FillAVX2,
+    ScanAVX2,
+    SwizzleAVX2,
+    ExpandAVX2,
+    WidenAVX2,
+    NarrowAVX2,
+    LookupAVX2,
+};
+
+static int HasAVX2(void)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return 0;
+    __cpuid(info, 1);
+    /* OSXSAVE and AVX, then check the OS saves the YMM registers */
+    if ((info[2] & 0x18000000) != 0x18000000 || (_xgetbv(0) & 6) != 6)
+        return 0;
+    __cpuidex(info, 7, 0);
+    return (info[1] & 0x20) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+#ifdef TGA_NEON
+static void FillNEON(unsigned char *p, const unsigned char *pixel, int bpp, long count)
+{
+    unsigned char pat[48];
+    long n = count * bpp;
+    uint8x16_t v0;
+    uint8x16_t v1;
+    uint8x16_t v2;
+
+    if (bpp == 1 || n < 32)
+    {
+        FillScalar(p, pixel, bpp, count);
+        return;
+    }
+    MakePattern(pat, pixel, bpp, 48);
+    v0 = vld1q_u8(pat);
+    v1 = vld1q_u8(pat + 16);
+    v2 = vld1q_u8(pat + 32);
+    for (; n >= 48; n -= 48, p += 48)
+    {
+        vst1q_u8(p, v0);
+        vst1q_u8(p + 16, v1);
+        vst1q_u8(p + 32, v2);
+    }
+    memcpy(p, pat, n);
+}
+
+/*
+** NEON has no byte mask extraction, so each vector is only tested for
+** any matching pair and the exact position is then found with scalar
+** code.  Three byte pixels do not fit the lanes and are scanned with
+** scalar code throughout.
+*/
+static long ScanNEON(const unsigned char *p, int bpp, long count, int equal)
+{
+    long pairs = 16 / bpp;
+    long i = 0;
+    uint8x16_t a;
+    uint8x16_t b;
+    uint8x16_t eq;
+
+    if (bpp == 3)
+        return ScanScalar(p, bpp, count, equal);
+    for (; (i + 1) * bpp + 16 <= count * bpp; i += pairs)
+    {
+        a = vld1q_u8(p + i * bpp);
+        b = vld1q_u8(p + (i + 1) * bpp);
+        if (bpp == 1)
+            eq = vceqq_u8(a, b);
+        else if (bpp == 2)
+            eq = vreinterpretq_u8_u16(vceqq_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b)));
+        else
+            eq = vreinterpretq_u8_u32(vceqq_u32(vreinterpretq_u32_u8(a), vreinterpretq_u32_u8(b)));
+        if (equal ? vmaxvq_u8(eq) != 0 : vminvq_u8(eq) == 0)
+            return i + ScanScalar(p + i * bpp, bpp, pairs + 1, equal);
+    }
+    return i + ScanScalar(p + i * bpp, bpp, count - i, equal);
+}
+
+static void SwizzleNEON(unsigned char *d, const unsigned char *s, long count, const TGASwizzle *sw)
+{
+    uint8x16_t in[4];
+    uint8x16_t out[4];
+    uint8x16_t k;
+    uint8x16x3_t v3;
+    uint8x16x4_t v4;
+    int sb = sw->srcBpp;
+    int db = sw->dstBpp;
+    int c;
+
+    if ((sb != 3 && sb != 4) || (db != 3 && db != 4))
+    {
+        SwizzleScalar(d, s, count, sw);
+        return;
+    }
+    /*
+    ** The structure loads and stores separate the channels of sixteen
+    ** pixels, which are then simply reordered.
+    */
+    k = vdupq_n_u8(sw->constant);
+    for (; count >= 16; count -= 16, s += 16 * sb, d += 16 * db)
+    {
+        if (sb == 4)
+        {
+            v4 = vld4q_u8(s);
+            for (c = 0; c < 4; ++c)
+                in[c] = v4.val[c];
+        }
+        else
+        {
+            v3 = vld3q_u8(s);
+            for (c = 0; c < 3; ++c)
+                in[c] = v3.val[c];
+        }
+        for (c = 0; c < db; ++c)
+        {
+            out[c] = sw->map[c] < 0 ? k : in[sw->map[c]];
+        }
+        if (db == 4)
+        {
+            for (c = 0; c < 4; ++c)
+                v4.val[c] = out[c];
+            vst4q_u8(d, v4);
+        }
+        else
+        {
+            for (c = 0; c < 3; ++c)
+                v3.val[c] = out[c];
+            vst3q_u8(d, v3);
+        }
+    }
+    SwizzleScalar(d, s, count, sw);
+}
+
+static const TGAKernels neonKernels =
+{
+    "NEON",
+    FillNEON,
+    ScanNEON,
+    SwizzleNEON,
+    ExpandScalar, /* no gather instruction */
+    WidenScalar,
+    NarrowScalar,
+    LookupScalar,
+};
+#endif
+
+/*
+** The choice depends only on the processor, so it is simply made again
+** on each call rather than cached in shared state.
+*/
+const TGAKernels *GetTGAKernels(void)
+{
+#ifdef TGA_AVX2
+    if (HasAVX2())
+        return &avx2Kernels;
+#endif
+#if defined(TGA_SSE2)
+    return &sse2Kernels;
+#elif defined(TGA_NEON)
+    return &neonKernels;
+#endif
+    return &scalarKernels;
+}
@@ -0,0 +1,62 @@
+/*
+** Pixel processing kernels shared by the library.  Each set of kernels
+** is written for one instruction set; GetTGAKernels picks the best set
+** supported by the processor the program is running on.
+*/
+#ifndef TGA_KERNELS_H
+#define TGA_KERNELS_H
+
+typedef struct _TGAKernels
+{
+    const char *name; /* instruction set used by the kernels */
+
+    /* store count copies of a bpp byte pixel at p */
+    void (*fill)(unsigned char *p, const unsigned char *pixel, int bpp, long count);
+
+    /*
+    ** Return the first index i of the count pixels at p for which the
+    ** comparison of pixels i and i + 1 for equality matches equal,
+    ** or count - 1 if there is no such pair.
+    */
+    long (*scan)(const unsigned char *p, int bpp, long count, int equal);
+
+    /*
+    ** Copy count pixels from s to d, rearranging the channels of each
+    ** pixel as described by sw, which has already been checked.
+    */
+    void (*swizzle)(unsigned char *d, const unsigned char *s, long count, const struct _TGASwizzle *sw);
+
+    /*
+    ** Store at d the colors of count color map indices of bpp bytes at
+    ** s, looked up in colors, which holds an entry for every possible
+    ** index, as pixels of dstBpp bytes, either 3 or 4.
+    */
+    void (*expand)(unsigned char *d, const unsigned char *s, long count, int bpp, const UINT32 *colors, int dstBpp);
+
+    /*
+    ** Widen count 16 bit pixels at s to pixels of dstBpp bytes, 3 or 4,
+    ** at d, as described for WidenTGAPixels.
+    */
+    void (*widen)(unsigned char *d, const unsigned char *s, long count, int dstBpp, int flags);
+
+    /*
+    ** Narrow count pixels of srcBpp bytes, 3 or 4, at s to 16 bit pixels
+    ** at d, which may be s.  When dither is not NULL, its four values are
+    ** added to the color channels of successive pixels in turn before
+    ** each channel is cut to 5 bits.
+    */
+    void (*narrow)(unsigned char *d, const unsigned char *s, long count, int srcBpp, int flags, const unsigned char *dither);
+
+    /*
+    ** Store at d count pixels of bpp bytes, 3 or 4, from s, which may be
+    ** d, with each byte replaced through the table for its position in
+    ** the pixel.  Entry v of the table for byte c is tables[c * 256 + v],
+    ** which holds the new value in its byte c in memory order and zero
+    ** in its other bytes, so the entries of a pixel may be combined.
+    */
+    void (*lookup)(unsigned char *d, const unsigned char *s, long count, int bpp, const UINT32 *tables);
+} TGAKernels;
+
+const TGAKernels *GetTGAKernels(void);
+
+#endif
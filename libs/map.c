@@ -0,0 +1,84 @@
+#include <config/file_io.h>
+
+#include <string.h>
+#include <tga.h>
+
+/*
+** Map an entire TGA file into memory and fill in the TGA structure
+** directly from the mapping.  Returns the same error codes as
+** ReadTGAFile, or TGA_READ_ERROR_MAP if the file could not be mapped.
+** The mapping is released on error; otherwise it remains valid until
+** UnmapTGAFile is called.
+*/
+int MapTGAFile(const char *fileName, TGAMap *mp, TGAFile *sp)
+{
+    file_map map;
+    int status;
+
+    if (fileName == NULL || mp == NULL || sp == NULL)
+    {
+        return TGA_READ_ERROR_NULL_ARGUMENT;
+    }
+    memset(mp, 0, sizeof(TGAMap));
+    if (file_map_open(fileName, &map) != 0)
+    {
+        return TGA_READ_ERROR_MAP;
+    }
+    mp->data = map.data;
+    mp->size = (long) map.size;
+    mp->handle = map.handle;
+    if (mp->data == NULL)
+    {
+        UnmapTGAFile(mp);
+        return TGA_READ_ERROR_READ_HEADER;
+    }
+    status = ReadTGAMemory(mp->data, mp->size, sp);
+    if (status < 0)
+    {
+        UnmapTGAFile(mp);
+    }
+    return status;
+}
+
+/*
+** For uncompressed image types, return a pointer to the image data
+** within the mapping, or NULL if the image is compressed or the file
+** is too short to hold all of the image data.
+*/
+const unsigned char *GetTGAMappedImage(TGAMap *mp, TGAFile *sp)
+{
+    long offset;
+    long size;
+
+    if (mp == NULL || sp == NULL || mp->data == NULL)
+    {
+        return NULL;
+    }
+    if (sp->imageType < 1 || sp->imageType > 3)
+    {
+        return NULL;
+    }
+    offset = GetTGADataOffset(sp);
+    size = ((sp->pixelDepth + 7) >> 3) * (long) sp->imageWidth * sp->imageHeight;
+    if (offset > mp->size || size > mp->size - offset)
+    {
+        return NULL;
+    }
+    return mp->data + offset;
+}
+
+void UnmapTGAFile(TGAMap *mp)
+{
+    file_map map;
+
+    if (mp->data != NULL)
+    {
+        map.data = mp->data;
+        map.size = (size_t) mp->size;
+        map.handle = mp->handle;
+        file_map_close(&map);
+    }
+    mp->data = NULL;
+    mp->size = 0;
+    mp->handle = NULL;
+}
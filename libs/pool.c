@@ -0,0 +1,144 @@
+#include <stdlib.h>
+
+#include <config/thread.h>
+
+#include "pool.h"
+
+#define MAXWORKERS 64 /* largest number of worker threads in a pool */
+
+typedef struct _TGAJob
+{
+    void (*func)(void *);
+    void *arg;
+    struct _TGAJob *next;
+} TGAJob;
+
+struct _TGAPool
+{
+    thread_mutex mutex;
+    thread_cond cond;
+    TGAJob *head;      /* next job to run */
+    TGAJob *tail;      /* last job submitted */
+    int quit;          /* set when the workers should exit */
+    int workers;       /* number of running worker threads */
+    thread_handle threads[MAXWORKERS];
+};
+
+static void RunWorker(void *arg)
+{
+    TGAPool *pool = arg;
+    TGAJob *job;
+
+    thread_mutex_lock(pool->mutex);
+    for (;;)
+    {
+        while (pool->head == NULL && !pool->quit)
+            thread_cond_wait(pool->cond, pool->mutex);
+        job = pool->head;
+        if (job == NULL)
+            break;
+        pool->head = job->next;
+        if (pool->head == NULL)
+            pool->tail = NULL;
+        thread_mutex_unlock(pool->mutex);
+        job->func(job->arg);
+        free(job);
+        thread_mutex_lock(pool->mutex);
+    }
+    thread_mutex_unlock(pool->mutex);
+}
+
+/*
+** Create a pool of up to threads workers.  Returns NULL only when the
+** pool itself cannot be allocated; failing to start workers leaves a
+** pool that runs jobs inline.
+*/
+TGAPool *CreateTGAPool(int threads)
+{
+    TGAPool *pool;
+
+    pool = calloc(1, sizeof(TGAPool));
+    if (pool == NULL)
+    {
+        return NULL;
+    }
+    if (threads > MAXWORKERS)
+    {
+        threads = MAXWORKERS;
+    }
+    if (threads < 2)
+    {
+        return pool;
+    }
+    if (thread_mutex_create(&pool->mutex) < 0)
+    {
+        free(pool);
+        return NULL;
+    }
+    if (thread_cond_create(&pool->cond) < 0)
+    {
+        thread_mutex_destroy(pool->mutex);
+        free(pool);
+        return NULL;
+    }
+    while (pool->workers < threads)
+    {
+        if (thread_start(&pool->threads[pool->workers], RunWorker, pool) < 0)
+            break;
+        pool->workers++;
+    }
+    return pool;
+}
+
+void SubmitTGAJob(TGAPool *pool, void (*func)(void *), void *arg)
+{
+    TGAJob *job;
+
+    job = pool->workers > 0 ? malloc(sizeof(TGAJob)) : NULL;
+    if (job == NULL)
+    {
+        func(arg);
+        return;
+    }
+    job->func = func;
+    job->arg = arg;
+    job->next = NULL;
+    thread_mutex_lock(pool->mutex);
+    if (pool->tail != NULL)
+        pool->tail->next = job;
+    else
+        pool->head = job;
+    pool->tail = job;
+    thread_cond_signal(pool->cond);
+    thread_mutex_unlock(pool->mutex);
+}
+
+/*
+** Run any jobs still queued, then stop the workers and free the pool.
+*/
+void DestroyTGAPool(TGAPool *pool)
+{
+    int i;
+
+    if (pool == NULL)
+    {
+        return;
+    }
+    if (pool->workers > 0)
+    {
+        thread_mutex_lock(pool->mutex);
+        pool->quit = 1;
+        thread_cond_broadcast(pool->cond);
+        thread_mutex_unlock(pool->mutex);
+        for (i = 0; i < pool->workers; ++i)
+        {
+            thread_join(pool->threads[i]);
+        }
+    }
+    if (pool->mutex != NULL)
+    {
+        thread_cond_destroy(pool->cond);
+        thread_mutex_destroy(pool->mutex);
+    }
+    free(pool);
+}
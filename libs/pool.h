@@ -0,0 +1,15 @@
+/*
+** A pool of worker threads running jobs submitted by the library.  A
+** pool created for a single thread, or on a platform without threads,
+** has no workers and runs each job on the submitting thread instead.
+*/
+#ifndef TGA_POOL_H
+#define TGA_POOL_H
+
+typedef struct _TGAPool TGAPool;
+
+TGAPool *CreateTGAPool(int threads);
+void SubmitTGAJob(TGAPool *pool, void (*func)(void *), void *arg);
+void DestroyTGAPool(TGAPool *pool);
+
+#endif
@@ -2,11 +2,14 @@
 #include <string.h>
 #include <tga.h>
 
+#include "kernels.h"
+
 #define RLEBUFSIZ 512 /* size of largest possible RLE packet */
-#define CBUFSIZE 2048 /* size of copy buffer */
 
-static char rleBuf[RLEBUFSIZ];
-static char copyBuf[CBUFSIZE];
+#define HEADER_SIZE 18   /* size of original TGA header */
+#define FOOTER_SIZE 26   /* size of extended TGA file footer */
+#define EXT_SIZE_20 495  /* version 2.0 extension area size */
+#define DEV_TAG_SIZE 10  /* size of a developer directory entry */
 
 static UINT8 ReadByte(FILE *fp)
 {
@@ -16,89 +19,221 @@ static UINT8 ReadByte(FILE *fp)
     return (value);
 }
 
-static UINT16 ReadShort(FILE *fp)
+UINT32 ReadLong(FILE *fp)
 {
-    UINT16 value;
+    UINT32 value;
 
-    fread(&value, 1, 2, fp);
+    fread(&value, 1, 4, fp);
     return (value);
 }
 
-UINT32 ReadLong(FILE *fp)
+/*
+** The TGA structures are stored little endian.  Each structure is read
+** with a single fread into a byte buffer, and the multi-byte fields are
+** then assembled explicitly so that structure alignment and host byte
+** order do not matter.  The same routines decode the structures of a
+** file held in memory.
+*/
+static UINT16 GetShort(const unsigned char *p)
 {
-    UINT32 value;
+    return (UINT16) (p[0] | (p[1] << 8));
+}
 
-    fread(&value, 1, 4, fp);
-    return (value);
+static UINT32 GetLong(const unsigned char *p)
+{
+    return (UINT32) p[0] | ((UINT32) p[1] << 8) | ((UINT32) p[2] << 16) | ((UINT32) p[3] << 24);
+}
+
+static void GetCharField(const unsigned char *p, char *q, int n)
+{
+    memcpy(q, p, n);
+}
+
+static void ParseHeader(const unsigned char *p, TGAFile *sp)
+{
+    sp->idLength = p[0];
+    sp->mapType = p[1];
+    sp->imageType = p[2];
+    sp->mapOrigin = GetShort(p + 3);
+    sp->mapLength = GetShort(p + 5);
+    sp->mapWidth = p[7];
+    sp->xOrigin = GetShort(p + 8);
+    sp->yOrigin = GetShort(p + 10);
+    sp->imageWidth = GetShort(p + 12);
+    sp->imageHeight = GetShort(p + 14);
+    sp->pixelDepth = p[16];
+    sp->imageDesc = p[17];
 }
 
-static void ReadCharField(FILE *fp, char *p, int n)
+/*
+** Returns non-zero if the footer identifies an extended TGA file.
+*/
+static int ParseFooter(const unsigned char *p, TGAFile *sp)
 {
-    while (n)
+    sp->extAreaOffset = GetLong(p);
+    sp->devDirOffset = GetLong(p + 4);
+    memcpy(sp->signature, p + 8, 17);
+    sp->signature[17] = '\0';
+    if (strcmp(sp->signature, "TRUEVISION-XFILE.") != 0)
     {
-        *p++ = (char) fgetc(fp); /* no error check, no char conversion */
-        --n;
+        sp->extAreaOffset = 0L;
+        sp->devDirOffset = 0L;
+        return 0;
     }
+    return 1;
 }
 
-static int ReadColorTable(FILE *fp, TGAFile *sp)
+static void ParseExtensionArea(const unsigned char *p, TGAFile *sp)
 {
-    UINT16 *p;
-    UINT16 n;
+    int i;
 
-    if (!fseek(fp, sp->colorCorrectOffset, SEEK_SET))
+    sp->extSize = GetShort(p);
+    GetCharField(p + 2, sp->author, 41);
+    for (i = 0; i < 4; ++i)
     {
-        sp->colorCorrectTable = malloc(1024 * sizeof(UINT16));
-        if ( sp->colorCorrectTable )
-        {
-            p = sp->colorCorrectTable;
-            for (n = 0; n < 1024; ++n)
-            {
-                *p++ = ReadShort(fp);
-            }
-        }
-        else
+        GetCharField(p + 43 + i * 81, &sp->authorCom[i][0], 81);
+    }
+    sp->month = GetShort(p + 367);
+    sp->day = GetShort(p + 369);
+    sp->year = GetShort(p + 371);
+    sp->hour = GetShort(p + 373);
+    sp->minute = GetShort(p + 375);
+    sp->second = GetShort(p + 377);
+    GetCharField(p + 379, sp->jobID, 41);
+    sp->jobHours = GetShort(p + 420);
+    sp->jobMinutes = GetShort(p + 422);
+    sp->jobSeconds = GetShort(p + 424);
+    GetCharField(p + 426, sp->softID, 41);
+    sp->versionNum = GetShort(p + 467);
+    sp->versionLet = p[469];
+    sp->keyColor = GetLong(p + 470);
+    sp->pixNumerator = GetShort(p + 474);
+    sp->pixDenominator = GetShort(p + 476);
+    sp->gammaNumerator = GetShort(p + 478);
+    sp->gammaDenominator = GetShort(p + 480);
+    sp->colorCorrectOffset = GetLong(p + 482);
+    sp->stampOffset = GetLong(p + 486);
+    sp->scanLineOffset = GetLong(p + 490);
+    sp->alphaAttribute = p[494];
+}
+
+/*
+** Returns non-zero if size bytes starting at offset lie within the data.
+*/
+static int InRange(long dataSize, UINT32 offset, long size)
+{
+    return (long) offset <= dataSize && size <= dataSize - (long) offset;
+}
+
+/*
+** Read a table of the extension area from the mapping or the file the
+** structure was read from.  The file position is left unchanged, so a
+** decoder reading the image data from the same file is not disturbed.
+*/
+static int LoadTable(TGAFile *sp, UINT32 offset, void *table, long size)
+{
+    long saved;
+    int status;
+
+    if (sp->sourceData != NULL)
+    {
+        if (!InRange(sp->sourceSize, offset, size))
         {
-            puts("Unable to allocate Color Correction Table.");
             return (-1);
         }
+        memcpy(table, sp->sourceData + offset, size);
+        return (0);
     }
-    else
+    if (sp->source == NULL)
     {
-        printf("Error seeking to Color Correction Table, offset = 0x%08x\n", sp->colorCorrectOffset);
         return (-1);
     }
-    return (0);
+    saved = ftell(sp->source);
+    if (saved < 0 || fseek(sp->source, offset, SEEK_SET) != 0)
+    {
+        return (-1);
+    }
+    status = fread(table, 1, size, sp->source) == (size_t) size ? 0 : -1;
+    if (fseek(sp->source, saved, SEEK_SET) != 0)
+    {
+        status = -1;
+    }
+    return (status);
 }
 
-static int ReadScanLineTable(FILE *fp, TGAFile *sp)
+/*
+** Return the color correction table, reading it on first use from the
+** file or mapping the structure was read from, which must still be open.
+** Returns NULL if the file has no table or it cannot be read.
+*/
+const UINT16 *GetTGAColorCorrectTable(TGAFile *sp)
 {
-    UINT32 *p;
+    unsigned char *p;
     UINT16 n;
 
-    if (!fseek(fp, sp->scanLineOffset, SEEK_SET))
+    if (sp == NULL)
     {
-        sp->scanLineTable = malloc(sp->imageHeight << 2);
-        if (sp->scanLineTable)
+        return (NULL);
+    }
+    if (sp->colorCorrectTable == NULL && sp->colorCorrectOffset)
+    {
+        sp->colorCorrectTable = malloc(1024 * sizeof(UINT16));
+        if (sp->colorCorrectTable == NULL)
         {
-            p = sp->scanLineTable;
-            for (n = 0; n < sp->imageHeight; ++n)
-            {
-                *p++ = ReadShort(fp);
-            }
+            return (NULL);
         }
-        else
+        /*
+        ** Read the table into place, then convert each entry from
+        ** file order over the bytes it was read from.
+        */
+        p = (unsigned char *) sp->colorCorrectTable;
+        if (LoadTable(sp, sp->colorCorrectOffset, p, 1024 * 2) < 0)
         {
-            puts("Unable to allocate Scan Line Table");
-            return (-1);
+            free(sp->colorCorrectTable);
+            sp->colorCorrectTable = NULL;
+            return (NULL);
+        }
+        for (n = 0; n < 1024; ++n, p += 2)
+        {
+            sp->colorCorrectTable[n] = GetShort(p);
         }
     }
-    else
+    return (sp->colorCorrectTable);
+}
+
+/*
+** Return the scan line table, reading it on first use in the same way
+** as the color correction table.
+*/
+const UINT32 *GetTGAScanLineTable(TGAFile *sp)
+{
+    unsigned char *p;
+    UINT16 n;
+
+    if (sp == NULL)
     {
-        printf("Error seeking to Scan Line Table, offset = 0x%08x\n", sp->scanLineOffset);
-        return (-1);
+        return (NULL);
     }
-    return (0);
+    if (sp->scanLineTable == NULL && sp->scanLineOffset && sp->imageHeight)
+    {
+        sp->scanLineTable = malloc(sp->imageHeight * sizeof(UINT32));
+        if (sp->scanLineTable == NULL)
+        {
+            return (NULL);
+        }
+        p = (unsigned char *) sp->scanLineTable;
+        if (LoadTable(sp, sp->scanLineOffset, p, 4L * sp->imageHeight) < 0)
+        {
+            free(sp->scanLineTable);
+            sp->scanLineTable = NULL;
+            return (NULL);
+        }
+        for (n = 0; n < sp->imageHeight; ++n, p += 4)
+        {
+            sp->scanLineTable[n] = GetLong(p);
+        }
+    }
+    return (sp->scanLineTable);
 }
 
 /*
@@ -108,8 +243,8 @@ static int ReadScanLineTable(FILE *fp, TGAFile *sp)
 int ReadRLERow(FILE *fp, unsigned char *p, int n, int bpp)
 {
     unsigned int value;
-    int i;
-    unsigned char *q;
+    unsigned char pixel[4];
+    const TGAKernels *kernels = GetTGAKernels();
 
     while (n > 0)
     {
@@ -121,19 +256,10 @@ int ReadRLERow(FILE *fp, unsigned char *p, int n, int bpp)
             n -= value * bpp;
             if (n < 0)
                 return (-1);
-            if (fread(rleBuf, 1, bpp, fp) != bpp)
+            if (fread(pixel, 1, bpp, fp) != bpp)
                 return (-1);
-            while (value > 0)
-            {
-                *p++ = rleBuf[0];
-                if (bpp > 1)
-                    *p++ = rleBuf[1];
-                if (bpp > 2)
-                    *p++ = rleBuf[2];
-                if (bpp > 3)
-                    *p++ = rleBuf[3];
-                value--;
-            }
+            kernels->fill(p, pixel, bpp, value);
+            p += value * bpp;
         }
         else
         {
@@ -142,70 +268,41 @@ int ReadRLERow(FILE *fp, unsigned char *p, int n, int bpp)
             if (n < 0)
                 return (-1);
             /*
-            ** Maximum for value is 128 so as long as RLEBUFSIZ
-            ** is at least 512, and bpp is not greater than 4
-            ** we can read in the entire raw packet with one operation.
+            ** The packet has been checked against the space remaining
+            ** in the row, so the raw pixels can be read in place.
             */
-            if (fread(rleBuf, bpp, value, fp) != value)
+            if (fread(p, bpp, value, fp) != value)
                 return (-1);
-            for (i = 0, q = rleBuf; i < (value * bpp); ++i)
-                *p++ = *q++;
+            p += value * bpp;
         }
     }
     return (0);
 }
 
-static int ReadExtendedTGA(FILE *fp, TGAFile *sp)
+/*
+** Read the extension area.  The tables it refers to are only checked to
+** lie within the file here, and are read when first asked for.
+*/
+static int ReadExtendedTGA(FILE *fp, long size, TGAFile *sp)
 {
+    unsigned char area[EXT_SIZE_20];
+    unsigned char stamp[2];
+
     if (!fseek(fp, sp->extAreaOffset, SEEK_SET))
     {
-        sp->extSize = ReadShort(fp);
-        memset(sp->author, 0, 41);
-        ReadCharField(fp, sp->author, 41);
-        memset(&sp->authorCom[0][0], 0, 81);
-        ReadCharField(fp, &sp->authorCom[0][0], 81);
-        memset(&sp->authorCom[1][0], 0, 81);
-        ReadCharField(fp, &sp->authorCom[1][0], 81);
-        memset(&sp->authorCom[2][0], 0, 81);
-        ReadCharField(fp, &sp->authorCom[2][0], 81);
-        memset(&sp->authorCom[3][0], 0, 81);
-        ReadCharField(fp, &sp->authorCom[3][0], 81);
-
-        sp->month = ReadShort(fp);
-        sp->day = ReadShort(fp);
-        sp->year = ReadShort(fp);
-        sp->hour = ReadShort(fp);
-        sp->minute = ReadShort(fp);
-        sp->second = ReadShort(fp);
-
-        memset(sp->jobID, 0, 41);
-        ReadCharField(fp, sp->jobID, 41);
-        sp->jobHours = ReadShort(fp);
-        sp->jobMinutes = ReadShort(fp);
-        sp->jobSeconds = ReadShort(fp);
-
-        memset(sp->softID, 0, 41);
-        ReadCharField(fp, sp->softID, 41);
-        sp->versionNum = ReadShort(fp);
-        sp->versionLet = ReadByte(fp);
-
-        sp->keyColor = ReadLong(fp);
-        sp->pixNumerator = ReadShort(fp);
-        sp->pixDenominator = ReadShort(fp);
-
-        sp->gammaNumerator = ReadShort(fp);
-        sp->gammaDenominator = ReadShort(fp);
-
-        sp->colorCorrectOffset = ReadLong(fp);
-        sp->stampOffset = ReadLong(fp);
-        sp->scanLineOffset = ReadLong(fp);
-
-        sp->alphaAttribute = ReadByte(fp);
-
-        sp->colorCorrectTable = (UINT16 *) NULL;
-        if (sp->colorCorrectOffset)
+        if (fread(area, 1, EXT_SIZE_20, fp) != EXT_SIZE_20)
+        {
+            return (-1);
+        }
+        ParseExtensionArea(area, sp);
+
+        if (sp->colorCorrectOffset && !InRange(size, sp->colorCorrectOffset, 1024 * 2))
+        {
+            return (-1);
+        }
+        if (sp->scanLineOffset && !InRange(size, sp->scanLineOffset, 4L * sp->imageHeight))
         {
-            ReadColorTable(fp, sp);
+            return (-1);
         }
 
         sp->postStamp = NULL;
@@ -213,20 +310,18 @@ static int ReadExtendedTGA(FILE *fp, TGAFile *sp)
         {
             if (!fseek(fp, sp->stampOffset, SEEK_SET))
             {
-                sp->stampWidth = ReadByte(fp);
-                sp->stampHeight = ReadByte(fp);
+                if (fread(stamp, 1, 2, fp) != 2)
+                {
+                    return (-1);
+                }
+                sp->stampWidth = stamp[0];
+                sp->stampHeight = stamp[1];
             }
             else
             {
                 printf("Error seeking to Postage Stamp, offset = 0x%08x\n", sp->stampOffset);
             }
         }
-
-        sp->scanLineTable = (UINT32 *) 0;
-        if (sp->scanLineOffset)
-        {
-            ReadScanLineTable(fp, sp);
-        }
     }
     else
     {
@@ -238,23 +333,46 @@ static int ReadExtendedTGA(FILE *fp, TGAFile *sp)
 
 static int ReadDeveloperDirectory(FILE *fp, TGAFile *sp)
 {
+    unsigned char count[2];
+    unsigned char *entries;
+    unsigned char *p;
     int i;
 
     if (!fseek(fp, sp->devDirOffset, SEEK_SET))
     {
-        sp->devTags = ReadShort(fp);
+        if (fread(count, 1, 2, fp) != 2)
+        {
+            return (-1);
+        }
+        sp->devTags = GetShort(count);
+        if (sp->devTags == 0)
+        {
+            return (0);
+        }
         sp->devDirs = malloc(sp->devTags * sizeof(DevDir));
-        if ( sp->devDirs == NULL )
+        entries = malloc(sp->devTags * DEV_TAG_SIZE);
+        if ( sp->devDirs == NULL || entries == NULL )
         {
+            free(entries);
+            free(sp->devDirs);
+            sp->devDirs = NULL;
             puts("Unable to allocate developer directory.");
             return (-1);
         }
-        for (i = 0; i < sp->devTags; ++i)
+        if (fread(entries, DEV_TAG_SIZE, sp->devTags, fp) != sp->devTags)
+        {
+            free(entries);
+            free(sp->devDirs);
+            sp->devDirs = NULL;
+            return (-1);
+        }
+        for (i = 0, p = entries; i < sp->devTags; ++i, p += DEV_TAG_SIZE)
         {
-            sp->devDirs[i].tagValue = ReadShort(fp);
-            sp->devDirs[i].tagOffset = ReadLong(fp);
-            sp->devDirs[i].tagSize = ReadLong(fp);
+            sp->devDirs[i].tagValue = GetShort(p);
+            sp->devDirs[i].tagOffset = GetLong(p + 2);
+            sp->devDirs[i].tagSize = GetLong(p + 6);
         }
+        free(entries);
     }
     else
     {
@@ -270,6 +388,7 @@ long CountRLEData(FILE *fp, unsigned int x, unsigned int y, int bytesPerPixel)
     long pixelCount;
     long totalPixels;
     unsigned int value;
+    char skipBuf[RLEBUFSIZ];
 
     n = 0L;
     pixelCount = 0L;
@@ -283,7 +402,7 @@ long CountRLEData(FILE *fp, unsigned int x, unsigned int y, int bytesPerPixel)
         {
             n += bytesPerPixel;
             pixelCount += (value & 0x7f) + 1;
-            if (fread(copyBuf, 1, bytesPerPixel, fp) != bytesPerPixel)
+            if (fread(skipBuf, 1, bytesPerPixel, fp) != bytesPerPixel)
             {
                 puts("Error counting RLE data.");
                 return (0L);
@@ -294,7 +413,7 @@ long CountRLEData(FILE *fp, unsigned int x, unsigned int y, int bytesPerPixel)
             value++;
             n += value * bytesPerPixel;
             pixelCount += value;
-            if (fread(copyBuf, bytesPerPixel, value, fp) != value)
+            if (fread(skipBuf, bytesPerPixel, value, fp) != value)
             {
                 puts("Error counting raw data.");
                 return (0L);
@@ -328,48 +447,39 @@ void FreeTGAFile(TGAFile *sp)
     }
 }
 
-static long FileSize(FILE *fp)
-{
-    long size;
-    long pos = ftell(fp);
-    fseek(fp, 0L, SEEK_END);
-    size = ftell(fp);
-    fseek(fp, pos, SEEK_SET);
-    return size;
-}
-
+/*
+** Fill in the TGA structure from the header, footer and extension area
+** of a file.  The color correction and scan line tables are not read
+** until asked for with GetTGAColorCorrectTable and GetTGAScanLineTable,
+** so the file must remain open until then.  On error nothing is left
+** allocated in the structure.
+*/
 int ReadTGAFile(FILE *fp, TGAFile *sp)
 {
+    unsigned char header[HEADER_SIZE];
+    unsigned char footer[FOOTER_SIZE];
+    long size;
     int xTGA = 0;
     if (fp == NULL || sp == NULL)
     {
         return TGA_READ_ERROR_NULL_ARGUMENT;
     }
+    /*
+    ** Clear any tables left from a previous image, which the decoder
+    ** would otherwise use for a file without an extension area.
+    */
+    memset(sp, 0, sizeof(TGAFile));
+    sp->source = fp;
 
     /*
-    ** It would be nice to be able to read in the entire
-    ** structure with one fread, but compiler dependent
-    ** structure alignment precludes the simplistic approach.
-    ** Instead, fill each field individually, and use routines
-    ** that will allow code to execute on various hosts by
-    ** recompilation with particular compiler flags.
-    **
     ** Start by reading the fields associated with the original
     ** TGA format.
     */
-    sp->idLength = ReadByte(fp);
-    sp->mapType = ReadByte(fp);
-    sp->imageType = ReadByte(fp);
-    sp->mapOrigin = ReadShort(fp);
-    sp->mapLength = ReadShort(fp);
-    sp->mapWidth = ReadByte(fp);
-    sp->xOrigin = ReadShort(fp);
-    sp->yOrigin = ReadShort(fp);
-    sp->imageWidth = ReadShort(fp);
-    sp->imageHeight = ReadShort(fp);
-    sp->pixelDepth = ReadByte(fp);
-    sp->imageDesc = ReadByte(fp);
-    memset(sp->idString, 0, 256);
+    if (fread(header, 1, HEADER_SIZE, fp) != HEADER_SIZE)
+    {
+        return TGA_READ_ERROR_READ_HEADER;
+    }
+    ParseHeader(header, sp);
     if (sp->idLength > 0 && fread(sp->idString, 1, sp->idLength, fp) != sp->idLength)
     {
         return TGA_READ_ERROR_READ_ID;
@@ -377,28 +487,16 @@ int ReadTGAFile(FILE *fp, TGAFile *sp)
     /*
     ** Now see if the file is the new (extended) TGA format.
     */
-    if (fseek(fp, -26, SEEK_END))
+    if (fseek(fp, -FOOTER_SIZE, SEEK_END))
     {
         return TGA_READ_ERROR_SEEK_END;
     }
-    sp->extAreaOffset = ReadLong(fp);
-    sp->devDirOffset = ReadLong(fp);
-    if (fgets(sp->signature, 18, fp) == NULL)
+    if (fread(footer, 1, FOOTER_SIZE, fp) != FOOTER_SIZE)
     {
         return TGA_READ_ERROR_READ_SIGNATURE;
     }
-    if (strcmp(sp->signature, "TRUEVISION-XFILE.") != 0)
-    {
-        /*
-        ** Reset offset values since this is not a new TGA file
-        */
-        sp->extAreaOffset = 0L;
-        sp->devDirOffset = 0L;
-    }
-    else
-    {
-        xTGA = 1;
-    }
+    size = ftell(fp);
+    xTGA = ParseFooter(footer, sp);
     /*
     ** If the file is an original TGA file, and falls into
     ** one of the uncompressed image types, we can perform
@@ -415,17 +513,252 @@ int ReadTGAFile(FILE *fp, TGAFile *sp)
         /* expect 8, 15, 16, 24, or 32 bits per map entry */
         fsize += ((sp->mapWidth + 7) >> 3) * (long) sp->mapLength;
         fsize += ((sp->pixelDepth + 7) >> 3) * (long) sp->imageWidth * sp->imageHeight;
-        if (fsize != FileSize(fp))
+        if (fsize != size)
         {
             return TGA_READ_ERROR_BAD_FILE_SIZE;
         }
     }
-    if (xTGA && sp->extAreaOffset && ReadExtendedTGA(fp, sp) < 0)
+    if (xTGA && sp->extAreaOffset && ReadExtendedTGA(fp, size, sp) < 0)
     {
+        FreeTGAFile(sp);
         return TGA_READ_ERROR_READ_EXTENDED;
     }
     if (xTGA && sp->devDirOffset && ReadDeveloperDirectory(fp, sp) < 0)
     {
+        FreeTGAFile(sp);
+        return TGA_READ_ERROR_READ_DEVELOPER_DIRECTORY;
+    }
+    return 0;
+}
+
+/*
+** Fill in the header and ID string only, reading exactly as far as the
+** color map and never seeking, so that an original TGA file can be read
+** from a pipe.  The extension area, if any, is not looked for.
+*/
+int ReadTGAHeader(FILE *fp, TGAFile *sp)
+{
+    unsigned char header[HEADER_SIZE];
+
+    if (fp == NULL || sp == NULL)
+    {
+        return TGA_READ_ERROR_NULL_ARGUMENT;
+    }
+    memset(sp, 0, sizeof(TGAFile));
+    if (fread(header, 1, HEADER_SIZE, fp) != HEADER_SIZE)
+    {
+        return TGA_READ_ERROR_READ_HEADER;
+    }
+    ParseHeader(header, sp);
+    if (sp->idLength > 0 && fread(sp->idString, 1, sp->idLength, fp) != sp->idLength)
+    {
+        return TGA_READ_ERROR_READ_ID;
+    }
+    return 0;
+}
+
+/*
+** Fill in the fields of the TGA structure selected by flags, without
+** allocating memory or reading the tables that follow the extension
+** area.  The header and ID string take a single read, and each selected
+** section one more, so the metadata of many files can be scanned cheaply.
+** The structure holds no tables afterward and need not be freed.  The
+** file size check of ReadTGAFile is made only when the footer is read.
+*/
+int ProbeTGAFile(FILE *fp, TGAFile *sp, int flags)
+{
+    unsigned char buf[EXT_SIZE_20]; /* also holds the header and ID */
+    size_t n;
+    long size;
+    int xTGA;
+
+    if (fp == NULL || sp == NULL)
+    {
+        return TGA_READ_ERROR_NULL_ARGUMENT;
+    }
+    memset(sp, 0, sizeof(TGAFile));
+    sp->source = fp;
+    n = fread(buf, 1, HEADER_SIZE + 255, fp);
+    if (n < HEADER_SIZE)
+    {
+        return TGA_READ_ERROR_READ_HEADER;
+    }
+    ParseHeader(buf, sp);
+    if (n < HEADER_SIZE + (size_t) sp->idLength)
+    {
+        return TGA_READ_ERROR_READ_ID;
+    }
+    memcpy(sp->idString, buf + HEADER_SIZE, sp->idLength);
+
+    if (flags & TGA_PROBE_STAMP)
+    {
+        flags |= TGA_PROBE_EXTENSION;
+    }
+    if (!(flags & (TGA_PROBE_FOOTER | TGA_PROBE_EXTENSION | TGA_PROBE_DEVELOPER)))
+    {
+        return 0;
+    }
+    if (fseek(fp, -FOOTER_SIZE, SEEK_END))
+    {
+        return TGA_READ_ERROR_SEEK_END;
+    }
+    if (fread(buf, 1, FOOTER_SIZE, fp) != FOOTER_SIZE)
+    {
+        return TGA_READ_ERROR_READ_SIGNATURE;
+    }
+    size = ftell(fp);
+    xTGA = ParseFooter(buf, sp);
+    if (sp->imageType > 0 && sp->imageType < 4 && !xTGA)
+    {
+        long fsize = HEADER_SIZE;
+        fsize += sp->idLength;
+        fsize += ((sp->mapWidth + 7) >> 3) * (long) sp->mapLength;
+        fsize += ((sp->pixelDepth + 7) >> 3) * (long) sp->imageWidth * sp->imageHeight;
+        if (fsize != size)
+        {
+            return TGA_READ_ERROR_BAD_FILE_SIZE;
+        }
+    }
+    if ((flags & TGA_PROBE_EXTENSION) && sp->extAreaOffset)
+    {
+        if (fseek(fp, sp->extAreaOffset, SEEK_SET) || fread(buf, 1, EXT_SIZE_20, fp) != EXT_SIZE_20)
+        {
+            return TGA_READ_ERROR_READ_EXTENDED;
+        }
+        ParseExtensionArea(buf, sp);
+        if ((flags & TGA_PROBE_STAMP) && sp->stampOffset)
+        {
+            if (fseek(fp, sp->stampOffset, SEEK_SET) || fread(buf, 1, 2, fp) != 2)
+            {
+                return TGA_READ_ERROR_READ_EXTENDED;
+            }
+            sp->stampWidth = buf[0];
+            sp->stampHeight = buf[1];
+        }
+    }
+    if ((flags & TGA_PROBE_DEVELOPER) && sp->devDirOffset)
+    {
+        if (fseek(fp, sp->devDirOffset, SEEK_SET) || fread(buf, 1, 2, fp) != 2)
+        {
+            return TGA_READ_ERROR_READ_DEVELOPER_DIRECTORY;
+        }
+        sp->devTags = GetShort(buf);
+    }
+    return 0;
+}
+
+static int ParseExtendedTGA(const unsigned char *data, long size, TGAFile *sp)
+{
+    if (!InRange(size, sp->extAreaOffset, EXT_SIZE_20))
+    {
+        return (-1);
+    }
+    ParseExtensionArea(data + sp->extAreaOffset, sp);
+    if (sp->colorCorrectOffset && !InRange(size, sp->colorCorrectOffset, 1024 * 2))
+    {
+        return (-1);
+    }
+    if (sp->stampOffset)
+    {
+        if (!InRange(size, sp->stampOffset, 2))
+        {
+            return (-1);
+        }
+        sp->stampWidth = data[sp->stampOffset];
+        sp->stampHeight = data[sp->stampOffset + 1];
+    }
+    if (sp->scanLineOffset && !InRange(size, sp->scanLineOffset, 4L * sp->imageHeight))
+    {
+        return (-1);
+    }
+    return (0);
+}
+
+static int ParseDeveloperDirectory(const unsigned char *data, long size, TGAFile *sp)
+{
+    const unsigned char *p;
+    int i;
+
+    if (!InRange(size, sp->devDirOffset, 2))
+    {
+        return (-1);
+    }
+    p = data + sp->devDirOffset;
+    sp->devTags = GetShort(p);
+    if (!InRange(size, sp->devDirOffset + 2, (long) sp->devTags * DEV_TAG_SIZE))
+    {
+        return (-1);
+    }
+    if (sp->devTags == 0)
+    {
+        return (0);
+    }
+    sp->devDirs = malloc(sp->devTags * sizeof(DevDir));
+    if (sp->devDirs == NULL)
+    {
+        return (-1);
+    }
+    for (i = 0, p += 2; i < sp->devTags; ++i, p += DEV_TAG_SIZE)
+    {
+        sp->devDirs[i].tagValue = GetShort(p);
+        sp->devDirs[i].tagOffset = GetLong(p + 2);
+        sp->devDirs[i].tagSize = GetLong(p + 6);
+    }
+    return (0);
+}
+
+/*
+** Fill in the TGA structure from a complete copy of the file contents,
+** such as a memory mapped file.  The same checks are performed, and the
+** same error codes returned, as for ReadTGAFile.  The data must remain
+** valid while the extension area tables may be asked for.  As with
+** ReadTGAFile, nothing is left allocated on error.
+*/
+int ReadTGAMemory(const unsigned char *data, long size, TGAFile *sp)
+{
+    int xTGA;
+
+    if (data == NULL || sp == NULL)
+    {
+        return TGA_READ_ERROR_NULL_ARGUMENT;
+    }
+    memset(sp, 0, sizeof(TGAFile));
+    sp->sourceData = data;
+    sp->sourceSize = size;
+    if (size < HEADER_SIZE)
+    {
+        return TGA_READ_ERROR_READ_HEADER;
+    }
+    ParseHeader(data, sp);
+    if (size < HEADER_SIZE + sp->idLength)
+    {
+        return TGA_READ_ERROR_READ_ID;
+    }
+    memcpy(sp->idString, data + HEADER_SIZE, sp->idLength);
+    if (size < FOOTER_SIZE)
+    {
+        return TGA_READ_ERROR_SEEK_END;
+    }
+    xTGA = ParseFooter(data + size - FOOTER_SIZE, sp);
+    if (sp->imageType > 0 && sp->imageType < 4 && !xTGA)
+    {
+        long fsize = HEADER_SIZE;
+        fsize += sp->idLength;
+        fsize += ((sp->mapWidth + 7) >> 3) * (long) sp->mapLength;
+        fsize += ((sp->pixelDepth + 7) >> 3) * (long) sp->imageWidth * sp->imageHeight;
+        if (fsize != size)
+        {
+            return TGA_READ_ERROR_BAD_FILE_SIZE;
+        }
+    }
+    if (xTGA && sp->extAreaOffset && ParseExtendedTGA(data, size, sp) < 0)
+    {
+        FreeTGAFile(sp);
+        return TGA_READ_ERROR_READ_EXTENDED;
+    }
+    if (xTGA && sp->devDirOffset && ParseDeveloperDirectory(data, size, sp) < 0)
+    {
+        FreeTGAFile(sp);
         return TGA_READ_ERROR_READ_DEVELOPER_DIRECTORY;
     }
     return 0;
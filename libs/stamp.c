@@ -0,0 +1,677 @@
+#include <stdlib.h>
+#include <string.h>
+#include <tga.h>
+
+#include <config/thread.h>
+
+#include "pool.h"
+
+#define BAND_BYTES 262144 /* approximate size of the rows in one band */
+#define CACHE_SIZE 1024   /* colors remembered when searching the color map */
+
+typedef struct _StampCache
+{
+    UINT32 color;               /* channels packed a byte each */
+    long entry;                 /* nearest color map entry */
+    int used;
+} StampCache;
+
+/*
+** A postage stamp is reduced from the image by averaging the pixels of
+** each cell, a box of image pixels covering one stamp pixel.  The image
+** is decoded once in order on the calling thread, while bands of rows
+** that all fall in one row of cells are added up on the pool.  Each band
+** adds its own totals first and then merges them into the totals of its
+** row of cells, so bands of the same row may be added concurrently.
+*/
+typedef struct _StampBand
+{
+    struct _StampState *state;
+    unsigned char *raw;         /* decoded rows of the band */
+    unsigned long long *partial; /* totals of the band for each cell */
+    long rows;                  /* number of rows in the band */
+    long cellRow;               /* row of cells holding the band */
+    int busy;                   /* set while the band is queued or being added */
+} StampBand;
+
+typedef struct _StampState
+{
+    thread_mutex mutex;
+    thread_cond cond;
+    int width;                  /* image width */
+    int bpp;                    /* bytes per image pixel */
+    long rowBytes;
+    int w;                      /* stamp width */
+    int channels;               /* channels added up for each pixel */
+    int *column;                /* cell column of each image column */
+    int *palette;               /* channels of each color map entry, or NULL */
+    long entries;               /* number of color map entries */
+    long mapOrigin;             /* index of the first color map entry */
+    unsigned long long *sums;   /* channel totals of every cell */
+} StampState;
+
+/*
+** Split a pixel of 1 to 4 bytes into channels that may be averaged.
+** Pixels of 2 bytes hold 5 bits each of blue, green and red, and an
+** attribute bit.  Returns the number of channels.
+*/
+static int GetChannels(const unsigned char *p, int bpp, int *c)
+{
+    unsigned int v;
+
+    switch (bpp)
+    {
+    case 1:
+        c[0] = p[0];
+        return 1;
+    case 2:
+        v = p[0] | (p[1] << 8);
+        c[0] = v & 0x1f;
+        c[1] = (v >> 5) & 0x1f;
+        c[2] = (v >> 10) & 0x1f;
+        c[3] = (v >> 15) & 1;
+        return 4;
+    case 3:
+        c[0] = p[0];
+        c[1] = p[1];
+        c[2] = p[2];
+        return 3;
+    default:
+        c[0] = p[0];
+        c[1] = p[1];
+        c[2] = p[2];
+        c[3] = p[3];
+        return 4;
+    }
+}
+
+static void PutChannels(unsigned char *p, int bpp, const int *c)
+{
+    unsigned int v;
+
+    switch (bpp)
+    {
+    case 1:
+        p[0] = (unsigned char) c[0];
+        break;
+    case 2:
+        v = c[0] | (c[1] << 5) | (c[2] << 10) | (c[3] << 15);
+        p[0] = (unsigned char) v;
+        p[1] = (unsigned char) (v >> 8);
+        break;
+    default:
+        p[0] = (unsigned char) c[0];
+        p[1] = (unsigned char) c[1];
+        p[2] = (unsigned char) c[2];
+        if (bpp > 3)
+            p[3] = (unsigned char) c[3];
+        break;
+    }
+}
+
+/*
+** Return the channels of an image pixel, looking up color mapped pixels
+** in the color map.  Indices outside the map take its first entry.
+*/
+static const int *PixelChannels(StampState *state, const unsigned char *p, int *c)
+{
+    long index;
+
+    if (state->palette == NULL)
+    {
+        GetChannels(p, state->bpp, c);
+        return c;
+    }
+    index = p[0];
+    if (state->bpp > 1)
+        index |= (long) p[1] << 8;
+    index -= state->mapOrigin;
+    if (index < 0 || index >= state->entries)
+        index = 0;
+    return state->palette + index * 4;
+}
+
+static void AddBandJob(void *arg)
+{
+    StampBand *bp = arg;
+    StampState *state = bp->state;
+    unsigned long long *sums;
+    unsigned long long *t;
+    const unsigned char *p;
+    const int *c;
+    int pixel[4];
+    long row;
+    long i;
+    int x;
+    int k;
+
+    for (row = 0; row < bp->rows; ++row)
+    {
+        p = bp->raw + row * state->rowBytes;
+        for (x = 0; x < state->width; ++x, p += state->bpp)
+        {
+            c = PixelChannels(state, p, pixel);
+            t = bp->partial + state->column[x] * 4;
+            for (k = 0; k < state->channels; ++k)
+                t[k] += (unsigned long long) c[k];
+        }
+    }
+    thread_mutex_lock(state->mutex);
+    sums = state->sums + bp->cellRow * state->w * 4;
+    for (i = 0; i < (long) state->w * 4; ++i)
+        sums[i] += bp->partial[i];
+    memset(bp->partial, 0, state->w * 4 * sizeof(unsigned long long));
+    bp->busy = 0;
+    thread_cond_broadcast(state->cond);
+    thread_mutex_unlock(state->mutex);
+}
+
+static void WaitBand(StampBand *bp)
+{
+    StampState *state = bp->state;
+
+    thread_mutex_lock(state->mutex);
+    while (bp->busy)
+        thread_cond_wait(state->cond, state->mutex);
+    thread_mutex_unlock(state->mutex);
+}
+
+/*
+** Find the color map entry nearest to the averaged channels of a cell.
+** Neighboring cells are often the same color, so recent answers are
+** remembered.
+*/
+static long NearestEntry(StampState *state, const int *c, StampCache *cache)
+{
+    StampCache *cp;
+    UINT32 color = 0;
+    long best = 0;
+    long bestDistance = -1;
+    long distance;
+    long d;
+    long i;
+    int k;
+
+    for (k = 0; k < state->channels; ++k)
+        color = (color << 8) | (UINT32) c[k];
+    cp = &cache[(color ^ (color >> 13)) % CACHE_SIZE];
+    if (cp->used && cp->color == color)
+        return cp->entry;
+    for (i = 0; i < state->entries && bestDistance != 0; ++i)
+    {
+        distance = 0;
+        for (k = 0; k < state->channels; ++k)
+        {
+            d = state->palette[i * 4 + k] - c[k];
+            distance += d * d;
+        }
+        if (bestDistance < 0 || distance < bestDistance)
+        {
+            best = i;
+            bestDistance = distance;
+        }
+    }
+    cp->color = color;
+    cp->entry = best;
+    cp->used = 1;
+    return best;
+}
+
+/*
+** Store averaged channels as a pixel, or for color mapped images as the
+** index of the nearest color map entry.
+*/
+static void StorePixel(StampState *state, unsigned char *p, const int *c, StampCache *cache)
+{
+    long index;
+
+    if (state->palette == NULL)
+    {
+        PutChannels(p, state->bpp, c);
+        return;
+    }
+    index = NearestEntry(state, c, cache) + state->mapOrigin;
+    p[0] = (unsigned char) index;
+    if (state->bpp > 1)
+        p[1] = (unsigned char) (index >> 8);
+}
+
+/*
+** Store the average of every cell in the stamp.
+*/
+static int FinishStamp(StampState *state, unsigned char *stamp, int h, long height)
+{
+    long *cols;
+    long *rows;
+    StampCache *cache = NULL;
+    unsigned long long *t;
+    unsigned long long count;
+    long y;
+    int c[4];
+    int x;
+    int k;
+
+    cols = calloc(state->w + h, sizeof(long));
+    if (cols == NULL)
+        return TGA_STAMP_ERROR_ALLOCATE;
+    rows = cols + state->w;
+    for (x = 0; x < state->width; ++x)
+        cols[state->column[x]]++;
+    for (y = 0; y < height; ++y)
+        rows[y * h / height]++;
+    if (state->palette != NULL)
+    {
+        cache = calloc(CACHE_SIZE, sizeof(StampCache));
+        if (cache == NULL)
+        {
+            free(cols);
+            return TGA_STAMP_ERROR_ALLOCATE;
+        }
+    }
+
+    memset(c, 0, sizeof(c));
+    for (y = 0; y < h; ++y)
+    {
+        for (x = 0; x < state->w; ++x)
+        {
+            t = state->sums + (y * state->w + x) * 4;
+            count = (unsigned long long) rows[y] * cols[x];
+            for (k = 0; k < state->channels; ++k)
+                c[k] = (int) ((t[k] + count / 2) / count);
+            StorePixel(state, stamp, c, cache);
+            stamp += state->bpp;
+        }
+    }
+    free(cache);
+    free(cols);
+    return 0;
+}
+
+/*
+** Describe the pixels read by a decoder, splitting the color map of a
+** color mapped image into channels.
+*/
+static int InitStampState(StampState *state, TGADecoder *dp, const unsigned char *colormap)
+{
+    TGAFile *sp = dp->sp;
+    int entryBytes;
+    long i;
+
+    memset(state, 0, sizeof(*state));
+    state->width = sp->imageWidth;
+    state->bpp = dp->pixelBytes;
+    state->rowBytes = dp->rowBytes;
+    state->channels = state->bpp == 2 ? 4 : state->bpp;
+    if ((sp->imageType == 1 || sp->imageType == 9) && dp->colors == NULL)
+    {
+        entryBytes = (sp->mapWidth + 7) >> 3;
+        if (colormap == NULL || sp->mapLength == 0 || entryBytes < 1 || entryBytes > 4)
+        {
+            return TGA_STAMP_ERROR_ARGUMENT;
+        }
+        state->entries = sp->mapLength;
+        state->mapOrigin = sp->mapOrigin;
+        state->palette = calloc(state->entries * 4, sizeof(int));
+        if (state->palette == NULL)
+        {
+            return TGA_STAMP_ERROR_ALLOCATE;
+        }
+        for (i = 0; i < state->entries; ++i)
+        {
+            state->channels = GetChannels(colormap + i * entryBytes, entryBytes, state->palette + i * 4);
+        }
+    }
+    return 0;
+}
+
+/*
+** Reduce the rest of the image read by a decoder, which must not have
+** decoded any rows, to a postage stamp of w by h pixels in the same
+** pixel format and row order as the image.  Every stamp pixel is the
+** average of the cell of image pixels it covers, so the stamp may be of
+** any size up to that of the image.  Color mapped pixels are averaged
+** through colormap, the color map entries as stored in the file, and
+** the nearest entry is chosen for each stamp pixel; colormap is ignored
+** for other images and for decoders expanding the color map.  With more
+** than one thread, the rows are added up in bands on the pool as they
+** are decoded.
+*/
+int CreateTGAStamp(TGADecoder *dp, const unsigned char *colormap, unsigned char *stamp, int w, int h, int threads)
+{
+    StampState state;
+    StampBand *bands;
+    StampBand *bp;
+    TGAPool *pool;
+    TGAFile *sp;
+    long bandRows;
+    long height;
+    long row;
+    long cellRow;
+    long i;
+    int slots;
+    int slot;
+    int x;
+    int status;
+
+    if (dp == NULL || dp->sp == NULL || stamp == NULL)
+    {
+        return TGA_STAMP_ERROR_NULL_ARGUMENT;
+    }
+    sp = dp->sp;
+    height = sp->imageHeight;
+    if (w < 1 || h < 1 || w > sp->imageWidth || h > height || dp->row != 0)
+    {
+        return TGA_STAMP_ERROR_ARGUMENT;
+    }
+    if (threads < 1)
+    {
+        threads = 1;
+    }
+
+    status = InitStampState(&state, dp, colormap);
+    if (status < 0)
+    {
+        return status;
+    }
+    state.w = w;
+    state.column = malloc(state.width * sizeof(int));
+    state.sums = calloc((size_t) w * h * 4, sizeof(unsigned long long));
+    if (state.column == NULL || state.sums == NULL)
+    {
+        free(state.column);
+        free(state.sums);
+        free(state.palette);
+        return TGA_STAMP_ERROR_ALLOCATE;
+    }
+    for (x = 0; x < state.width; ++x)
+    {
+        state.column[x] = (int) ((long) x * w / state.width);
+    }
+    bandRows = BAND_BYTES / state.rowBytes;
+    if (bandRows < 1)
+    {
+        bandRows = 1;
+    }
+
+    /*
+    ** Two bands per thread keep the workers busy while the next band is
+    ** decoded.
+    */
+    slots = threads > 1 ? 2 * threads : 1;
+    bands = calloc(slots, sizeof(StampBand));
+    pool = NULL;
+    if (bands == NULL || thread_mutex_create(&state.mutex) < 0 || thread_cond_create(&state.cond) < 0)
+    {
+        status = TGA_STAMP_ERROR_ALLOCATE;
+    }
+    for (slot = 0; slot < slots && status == 0; ++slot)
+    {
+        bands[slot].state = &state;
+        bands[slot].raw = malloc((size_t) bandRows * state.rowBytes);
+        bands[slot].partial = calloc((size_t) w * 4, sizeof(unsigned long long));
+        if (bands[slot].raw == NULL || bands[slot].partial == NULL)
+            status = TGA_STAMP_ERROR_ALLOCATE;
+    }
+    if (status == 0)
+    {
+        pool = CreateTGAPool(threads);
+        if (pool == NULL)
+            status = TGA_STAMP_ERROR_ALLOCATE;
+    }
+
+    slot = 0;
+    row = 0;
+    while (row < height && status == 0)
+    {
+        bp = &bands[slot];
+        WaitBand(bp);
+        cellRow = row * h / height;
+        for (i = 0; i < bandRows && row < height && row * h / height == cellRow; ++i, ++row)
+        {
+            if (DecodeTGARow(dp, bp->raw + i * state.rowBytes) < 0)
+            {
+                status = TGA_STAMP_ERROR_READ;
+                break;
+            }
+        }
+        if (status < 0)
+            break;
+        bp->rows = i;
+        bp->cellRow = cellRow;
+        bp->busy = 1;
+        SubmitTGAJob(pool, AddBandJob, bp);
+        slot = (slot + 1) % slots;
+    }
+
+    /*
+    ** Destroying the pool finishes the bands still queued.
+    */
+    DestroyTGAPool(pool);
+    if (status == 0)
+    {
+        status = FinishStamp(&state, stamp, h, height);
+    }
+    for (slot = 0; bands != NULL && slot < slots; ++slot)
+    {
+        free(bands[slot].raw);
+        free(bands[slot].partial);
+    }
+    free(bands);
+    thread_cond_destroy(state.cond);
+    thread_mutex_destroy(state.mutex);
+    free(state.column);
+    free(state.sums);
+    free(state.palette);
+    return status;
+}
+
+/*
+** A level of a pyramid collects the totals of one of its rows at a time
+** from two rows of the level above it, or of the image for the first
+** level.  Pairs of columns are added into each column, so the totals
+** stay exact all the way down and each level is the average of the
+** image pixels it covers rather than an average of averages.
+*/
+typedef struct _PyramidLevel
+{
+    unsigned long long *sums;   /* channel totals of the row being built */
+    long *columns;              /* image columns covered by each column */
+    long rows;                  /* image rows added to the row being built */
+    int added;                  /* rows of the level above added */
+    long row;                   /* next row of the level to store */
+} PyramidLevel;
+
+static void AddPyramidRow(StampState *state, PyramidLevel *levels, TGAPyramid *pp, int k, const unsigned long long *in, int inWidth, long inRows, StampCache *cache);
+
+/*
+** Store the row being built in level k and pass its totals on to the
+** next level.
+*/
+static void FinishPyramidRow(StampState *state, PyramidLevel *levels, TGAPyramid *pp, int k, StampCache *cache)
+{
+    PyramidLevel *lp = &levels[k];
+    unsigned char *p;
+    unsigned long long *t;
+    unsigned long long count;
+    int c[4];
+    int x;
+    int n;
+
+    memset(c, 0, sizeof(c));
+    p = pp->pixels[k] + lp->row * pp->width[k] * state->bpp;
+    for (x = 0; x < pp->width[k]; ++x, p += state->bpp)
+    {
+        t = lp->sums + x * 4;
+        count = (unsigned long long) lp->rows * lp->columns[x];
+        for (n = 0; n < state->channels; ++n)
+            c[n] = (int) ((t[n] + count / 2) / count);
+        StorePixel(state, p, c, cache);
+    }
+    lp->row++;
+    if (k + 1 < pp->levels)
+    {
+        AddPyramidRow(state, levels, pp, k + 1, lp->sums, pp->width[k], lp->rows, cache);
+    }
+    memset(lp->sums, 0, pp->width[k] * 4 * sizeof(unsigned long long));
+    lp->rows = 0;
+    lp->added = 0;
+}
+
+/*
+** Add the totals of a row of the level above, covering inRows image
+** rows, to level k.
+*/
+static void AddPyramidRow(StampState *state, PyramidLevel *levels, TGAPyramid *pp, int k, const unsigned long long *in, int inWidth, long inRows, StampCache *cache)
+{
+    PyramidLevel *lp = &levels[k];
+    unsigned long long *t;
+    int x;
+    int n;
+
+    for (x = 0; x < inWidth; ++x, in += 4)
+    {
+        t = lp->sums + (x >> 1) * 4;
+        for (n = 0; n < state->channels; ++n)
+            t[n] += in[n];
+    }
+    lp->rows += inRows;
+    if (++lp->added == 2)
+    {
+        FinishPyramidRow(state, levels, pp, k, cache);
+    }
+}
+
+/*
+** Reduce the rest of the image read by a decoder, which must not have
+** decoded any rows, to a pyramid of up to count levels, each half the
+** width and height of the one above, rounded up.  The image is decoded
+** once and every level is built as its rows are read.  Levels stop
+** once a level of a single pixel is reached.  Pixels are averaged as
+** for CreateTGAStamp, and the levels are in the pixel format and row
+** order of the image.  FreeTGAPyramid releases the levels.
+*/
+int CreateTGAPyramid(TGADecoder *dp, const unsigned char *colormap, TGAPyramid *pp, int count)
+{
+    StampState state;
+    PyramidLevel levels[TGA_PYRAMID_LEVELS];
+    StampCache *cache = NULL;
+    unsigned char *raw = NULL;
+    unsigned long long *in = NULL;
+    const int *c;
+    int pixel[4];
+    long row;
+    int width, height;
+    int status;
+    int k;
+    int x;
+    int n;
+
+    if (dp == NULL || dp->sp == NULL || pp == NULL)
+    {
+        return TGA_STAMP_ERROR_NULL_ARGUMENT;
+    }
+    memset(pp, 0, sizeof(*pp));
+    memset(levels, 0, sizeof(levels));
+    if (count < 1 || dp->row != 0 || dp->sp->imageWidth == 0 || dp->sp->imageHeight == 0)
+    {
+        return TGA_STAMP_ERROR_ARGUMENT;
+    }
+    status = InitStampState(&state, dp, colormap);
+    if (status < 0)
+    {
+        return status;
+    }
+
+    width = state.width;
+    height = dp->sp->imageHeight;
+    while (pp->levels < count && pp->levels < TGA_PYRAMID_LEVELS && (width > 1 || height > 1))
+    {
+        width = (width + 1) >> 1;
+        height = (height + 1) >> 1;
+        pp->width[pp->levels] = width;
+        pp->height[pp->levels] = height;
+        pp->levels++;
+    }
+    for (k = 0; k < pp->levels && status == 0; ++k)
+    {
+        pp->pixels[k] = malloc((size_t) pp->width[k] * pp->height[k] * state.bpp);
+        levels[k].sums = calloc((size_t) pp->width[k] * 4, sizeof(unsigned long long));
+        levels[k].columns = calloc(pp->width[k], sizeof(long));
+        if (pp->pixels[k] == NULL || levels[k].sums == NULL || levels[k].columns == NULL)
+        {
+            status = TGA_STAMP_ERROR_ALLOCATE;
+            break;
+        }
+        width = k == 0 ? state.width : pp->width[k - 1];
+        for (x = 0; x < width; ++x)
+        {
+            levels[k].columns[x >> 1] += k == 0 ? 1 : levels[k - 1].columns[x];
+        }
+    }
+    raw = malloc(state.rowBytes);
+    in = malloc((size_t) state.width * 4 * sizeof(unsigned long long));
+    if (state.palette != NULL)
+    {
+        cache = calloc(CACHE_SIZE, sizeof(StampCache));
+    }
+    if (raw == NULL || in == NULL || (state.palette != NULL && cache == NULL))
+    {
+        status = TGA_STAMP_ERROR_ALLOCATE;
+    }
+
+    for (row = 0; row < dp->sp->imageHeight && pp->levels > 0 && status == 0; ++row)
+    {
+        if (DecodeTGARow(dp, raw) < 0)
+        {
+            status = TGA_STAMP_ERROR_READ;
+            break;
+        }
+        for (x = 0; x < state.width; ++x)
+        {
+            c = PixelChannels(&state, raw + x * state.bpp, pixel);
+            for (n = 0; n < state.channels; ++n)
+                in[x * 4 + n] = (unsigned long long) c[n];
+        }
+        AddPyramidRow(&state, levels, pp, 0, in, state.width, 1, cache);
+    }
+
+    /*
+    ** A level of odd height ends with a row made from a single row of
+    ** the level above.  Finishing it may in turn finish the next level.
+    */
+    for (k = 0; k < pp->levels && status == 0; ++k)
+    {
+        if (levels[k].added > 0)
+            FinishPyramidRow(&state, levels, pp, k, cache);
+    }
+
+    for (k = 0; k < TGA_PYRAMID_LEVELS; ++k)
+    {
+        free(levels[k].sums);
+        free(levels[k].columns);
+    }
+    free(cache);
+    free(in);
+    free(raw);
+    free(state.palette);
+    if (status < 0)
+    {
+        FreeTGAPyramid(pp);
+    }
+    return status;
+}
+
+void FreeTGAPyramid(TGAPyramid *pp)
+{
+    int k;
+
+    if (pp == NULL)
+    {
+        return;
+    }
+    for (k = 0; k < TGA_PYRAMID_LEVELS; ++k)
+    {
+        free(pp->pixels[k]);
+    }
+    memset(pp, 0, sizeof(*pp));
+}
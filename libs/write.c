@@ -1,8 +1,10 @@
+#include <stdlib.h>
+#include <string.h>
 #include <tga.h>
 
-#define CBUFSIZE 2048 /* size of copy buffer */
+#include "kernels.h"
 
-static char copyBuf[CBUFSIZE];
+#define CBUFSIZE 2048 /* size of copy buffer */
 
 int WriteByte(FILE *fp, UINT8 uc)
 {
@@ -34,10 +36,12 @@ int WriteStr(FILE *fp, char *p, int n)
 
 int WriteColorCorrectTable(TGAFile *sp, FILE *fp)
 {
-    UINT16 *p;
+    const UINT16 *p;
     UINT16 n;
 
-    p = sp->colorCorrectTable;
+    p = GetTGAColorCorrectTable(sp);
+    if (p == NULL)
+        return -1;
     for (n = 0; n < 1024; ++n)
     {
         if (WriteShort(fp, *p++) < 0)
@@ -47,128 +51,147 @@ int WriteColorCorrectTable(TGAFile *sp, FILE *fp)
 }
 
 /*
-** Retrieve a pixel value from a buffer.  The actual size and order
-** of the bytes is not important since we are only using the value
-** for comparisons with other pixels.
-*/
-static UINT32 GetPixel(unsigned char *p, int bpp)
+char    *p;             data to be encoded
+char    *q;             encoded buffer
+int     n;              number of pixels in buffer
+int     bpp;            bytes per pixel
+ */
+int RLEncodeRow(char *p, char *q, int n, int bpp)
 {
-    unsigned long pixel;
+    const TGAKernels *kernels = GetTGAKernels();
+    unsigned char *s = (unsigned char *) p;
+    unsigned char *d = (unsigned char *) q;
+    long limit;     /* pixels that can affect the next packet */
+    long count;     /* pixels in the next packet */
 
-    pixel = (unsigned long) *p++;
-    while (bpp-- > 1)
+    /*
+    ** A packet never holds more than 128 pixels, so the scan for the end
+    ** of a packet need not look beyond the following pixel.  A run ends
+    ** at the first pair of adjacent pixels that differ, and a sequence
+    ** of raw pixels ends just before the first pair that are identical.
+    */
+    while (n > 0)
     {
-        pixel <<= 8;
-        pixel |= (unsigned long) *p++;
+        limit = n < 129 ? n : 129;
+        if (n > 1 && memcmp(s, s + bpp, bpp) == 0)
+        {
+            count = kernels->scan(s, bpp, limit, 0) + 1;
+            if (count > 128)
+                count = 128;
+            *d++ = (unsigned char) ((count - 1) | 0x80);
+            memcpy(d, s, bpp);
+            d += bpp;
+        }
+        else
+        {
+            /*
+            ** Without an identical pair the raw packet stops short of
+            ** the last pixel, which then starts a packet of its own.
+            ** This matches the output of earlier versions exactly.
+            */
+            count = n > 1 ? kernels->scan(s, bpp, limit, 1) : 1;
+            *d++ = (unsigned char) (count - 1);
+            memcpy(d, s, count * bpp);
+            d += count * bpp;
+        }
+        s += count * bpp;
+        n -= (int) count;
     }
-    return pixel;
+    return (int) (d - (unsigned char *) q);
 }
 
 /*
-** Count pixels in buffer until two identical adjacent ones found
+** Encode a row like RLEncodeRow, but choose the packets that give the
+** smallest encoding rather than taking each packet greedily.  The least
+** size of the first j pixels, cost[j], is found from either a raw packet
+** ending at pixel j, whose best start is the cheapest of the previous
+** 128 positions kept in a sliding window, or a run packet ending at j,
+** which is best started as early as the run allows since cost never
+** decreases.  The row is encoded greedily if no memory is available.
 */
-static int CountDiffPixels(char *p, int bpp, int pixCnt)
+int RLEncodeRowOptimal(char *p, char *q, int n, int bpp)
 {
-    unsigned long pixel;
-    unsigned long nextPixel;
-    int n;
+    unsigned char *s = (unsigned char *) p;
+    unsigned char *d = (unsigned char *) q;
+    long *cost;     /* least size of the first j pixels */
+    int *from;      /* start of the last packet of the best encoding */
+    int *window;    /* candidate raw packet starts, then packet ends */
+    char *run;      /* non-zero when the last packet is a run */
+    int head;
+    int tail;
+    int start;      /* first pixel of the run holding pixel j - 1 */
+    int i;
+    int j;
+    long raw;
+
+    if (n < 1)
+        return 0;
+    cost = malloc((n + 1) * (sizeof(long) + 2 * sizeof(int) + 1));
+    if (cost == NULL)
+        return RLEncodeRow(p, q, n, bpp);
+    from = (int *) (cost + n + 1);
+    window = from + n + 1;
+    run = (char *) (window + n + 1);
 
-    n = 0;
-    if (pixCnt == 1)
-        return pixCnt;
-    pixel = GetPixel(p, bpp);
-    while (pixCnt > 1)
+    cost[0] = 0;
+    head = tail = 0;
+    start = 0;
+    for (j = 1; j <= n; ++j)
     {
-        p += bpp;
-        nextPixel = GetPixel(p, bpp);
-        if (nextPixel == pixel)
-            break;
-        pixel = nextPixel;
-        ++n;
-        --pixCnt;
-    }
-    if (nextPixel == pixel)
-        return n;
-    return n + 1;
-}
+        if (j > 1 && memcmp(s + (j - 1) * bpp, s + (j - 2) * bpp, bpp) != 0)
+            start = j - 1;
 
-static int CountSamePixels(char *p, int bpp, int pixCnt)
-{
-    unsigned long pixel;
-    unsigned long nextPixel;
-    int n;
+        /*
+        ** The window holds starts in increasing order of both position
+        ** and cost[i] - i * bpp, so its head is the best raw start.
+        */
+        while (tail > head && cost[window[tail - 1]] - (long) window[tail - 1] * bpp >= cost[j - 1] - (long) (j - 1) * bpp)
+            --tail;
+        window[tail++] = j - 1;
+        if (window[head] < j - 128)
+            ++head;
+        i = window[head];
+        raw = cost[i] + 1 + (long) (j - i) * bpp;
+        cost[j] = raw;
+        from[j] = i;
+        run[j] = 0;
 
-    n = 1;
-    pixel = GetPixel(p, bpp);
-    pixCnt--;
-    while (pixCnt > 0)
-    {
-        p += bpp;
-        nextPixel = GetPixel(p, bpp);
-        if (nextPixel != pixel)
-            break;
-        ++n;
-        --pixCnt;
+        i = start > j - 128 ? start : j - 128;
+        if (j - i > 1 && cost[i] + 1 + bpp < raw)
+        {
+            cost[j] = cost[i] + 1 + bpp;
+            from[j] = i;
+            run[j] = 1;
+        }
     }
-    return n;
-}
 
-/*
-char    *p;             data to be encoded
-char    *q;             encoded buffer
-int     n;              number of pixels in buffer
-int     bpp;            bytes per pixel
- */
-int RLEncodeRow(char *p, char *q, int n, int bpp)
-{
-    int diffCount;  /* pixel count until two identical */
-    int sameCount;  /* number of identical adjacent pixels */
-    int RLEBufSize; /* count of number of bytes encoded */
-
-    RLEBufSize = 0;
-    while (n > 0)
+    /*
+    ** Follow the packets back from the end of the row, then write them
+    ** out from the start.
+    */
+    tail = 0;
+    for (j = n; j > 0; j = from[j])
+        window[tail++] = j;
+    i = 0;
+    while (tail > 0)
     {
-        diffCount = CountDiffPixels(p, bpp, n);
-        sameCount = CountSamePixels(p, bpp, n);
-        if (diffCount > 128)
-            diffCount = 128;
-        if (sameCount > 128)
-            sameCount = 128;
-        if (diffCount > 0)
+        j = window[--tail];
+        if (run[j])
         {
-            /* create a raw packet */
-            *q++ = (char) (diffCount - 1);
-            n -= diffCount;
-            RLEBufSize += diffCount * bpp + 1;
-            while (diffCount > 0)
-            {
-                *q++ = *p++;
-                if (bpp > 1)
-                    *q++ = *p++;
-                if (bpp > 2)
-                    *q++ = *p++;
-                if (bpp > 3)
-                    *q++ = *p++;
-                diffCount--;
-            }
+            *d++ = (unsigned char) ((j - i - 1) | 0x80);
+            memcpy(d, s + i * bpp, bpp);
+            d += bpp;
         }
-        if (sameCount > 1)
+        else
         {
-            /* create a RLE packet */
-            *q++ = (char) (sameCount - 1 | 0x80);
-            n -= sameCount;
-            RLEBufSize += bpp + 1;
-            p += (sameCount - 1) * bpp;
-            *q++ = *p++;
-            if (bpp > 1)
-                *q++ = *p++;
-            if (bpp > 2)
-                *q++ = *p++;
-            if (bpp > 3)
-                *q++ = *p++;
+            *d++ = (unsigned char) (j - i - 1);
+            memcpy(d, s + i * bpp, (j - i) * bpp);
+            d += (j - i) * bpp;
         }
+        i = j;
     }
-    return RLEBufSize;
+    free(cost);
+    return (int) (d - (unsigned char *) q);
 }
 
 int WriteTGAFile(TGAFile *sp, FILE *ofp)
@@ -235,35 +258,33 @@ int WriteTGAFile(TGAFile *sp, FILE *ofp)
 
 int CopyTGAColormap(TGAFile *sp, FILE *in, FILE *out)
 {
+    char copyBuf[CBUFSIZE];
+    long byteCount;
+    int n;
+
     /*
      ** Now we need to copy the color map data from the input file
-     ** to the output file.
+     ** to the output file.  An input that cannot seek, such as a pipe,
+     ** must already be at the color map.
      */
-    int byteCount = 18 + sp->idLength;
-    if (fseek(in, byteCount, SEEK_SET) != 0)
+    byteCount = 18 + sp->idLength;
+    if (fseek(in, byteCount, SEEK_SET) != 0 && ftell(in) >= 0)
     {
         return -1;
     }
     byteCount = ((sp->mapWidth + 7) >> 3) * (long) sp->mapLength;
     while (byteCount > 0)
     {
-        if (byteCount - CBUFSIZE < 0)
+        n = byteCount < CBUFSIZE ? (int) byteCount : CBUFSIZE;
+        if ((int) fread(copyBuf, 1, n, in) != n)
         {
-            fread(copyBuf, 1, (int) byteCount, in);
-            if (fwrite(copyBuf, 1, (int) byteCount, out) != (int) byteCount)
-            {
-                return -1;
-            }
+            return -1;
         }
-        else
+        if ((int) fwrite(copyBuf, 1, n, out) != n)
         {
-            fread(copyBuf, 1, CBUFSIZE, in);
-            if (fwrite(copyBuf, 1, CBUFSIZE, out) != CBUFSIZE)
-            {
-                return -1;
-            }
+            return -1;
         }
-        byteCount -= CBUFSIZE;
+        byteCount -= n;
     }
     return 0;
 }
@@ -16,6 +16,7 @@
 #include <tga.h>
 
 extern int              main( int, char ** );
+extern int              PrintBrief( int, char ** );
 extern void             PrintColorTable( TGAFile * );
 extern void             PrintExtendedTGA( TGAFile * );
 extern void             PrintImageType( int );
@@ -81,6 +82,14 @@ int main(int argc, char **argv)
 
         puts( versionStr );
         /*
+        ** The -brief option prints one line for each of any number of
+        ** files, reading only the header and extension area.
+        */
+        if ( argc > 1 && strcmp( argv[1], "-brief" ) == 0 )
+        {
+                return( PrintBrief( argc - 2, argv + 2 ) );
+        }
+        /*
         ** The program can be invoked without an argument, in which case
         ** the user will be prompted for the name of the image file to be
         ** examined, or the image file name can be provided as an argument
@@ -103,6 +112,7 @@ int main(int argc, char **argv)
         if ( fileName[0] == '-' )
         {
                 puts( "Usage: tgadump [filename]" );
+                puts( "       tgadump -brief filename ..." );
                 exit( 0 );
         }
         /*
@@ -169,6 +179,10 @@ int main(int argc, char **argv)
                 {
                         switch ( readStatus )
                         {
+                        case TGA_READ_ERROR_READ_HEADER:
+                                puts( "Couldn't read TGA header, file is truncated." );
+                                break;
+
                         case TGA_READ_ERROR_READ_ID:
                                 puts( "Couldn't read id." );
                                 break;
@@ -201,13 +215,59 @@ int main(int argc, char **argv)
 }
 
 
+/*
+** Print the size, depth and type of each file, along with the date and
+** software ID from the extension area, one file per line.  Only the
+** sections needed are read, so large collections can be scanned quickly.
+*/
+int PrintBrief( int argc, char **argv )
+{
+        FILE            *fp;
+        int                     status = 0;
+        int                     strSize;
+        char            *blankChars = " \t";
+
+        for ( ; argc > 0; --argc, ++argv )
+        {
+                if ( ( fp = fopen( *argv, "rb" ) ) == NULL )
+                {
+                        printf( "%s: unable to open\n", *argv );
+                        status = 1;
+                        continue;
+                }
+                if ( ProbeTGAFile( fp, &f, TGA_PROBE_EXTENSION ) < 0 )
+                {
+                        printf( "%s: not a valid TGA file\n", *argv );
+                        status = 1;
+                }
+                else
+                {
+                        printf( "%s: %u x %u, %u bits, type %u", *argv,
+                                f.imageWidth, f.imageHeight, f.pixelDepth, f.imageType );
+                        if ( f.month )
+                        {
+                                printf( ", saved %02u/%02u/%4u", f.month, f.day, f.year );
+                        }
+                        strSize = strlen( f.softID );
+                        if ( strSize && (int)strspn( f.softID, blankChars ) < strSize )
+                        {
+                                printf( ", %s", f.softID );
+                        }
+                        putchar( '\n' );
+                }
+                fclose( fp );
+        }
+        return( status );
+}
+
+
 void PrintColorTable(TGAFile *sp)
 {
         unsigned int    n;
-        UINT16                  *p;
+        const UINT16            *p;
 
         puts( "Color Correction Table:" );
-        p = sp->colorCorrectTable;
+        p = GetTGAColorCorrectTable( sp );
         for ( n = 0; n < 256; ++n )
         {
                 printf( "Color Entry %3u: 0x%04x(%5u) A, ", n, *p, *p );
@@ -319,7 +379,7 @@ void PrintExtendedTGA(TGAFile *sp) /* TGA structure pointer */
         {
                 printf( "Color Correction Offset            = 0x%08x\n",
                                         sp->colorCorrectOffset);
-                if ( sp->colorCorrectTable )
+                if ( GetTGAColorCorrectTable( sp ) )
                 {
                         PrintColorTable( sp );
                 }
@@ -335,7 +395,7 @@ void PrintExtendedTGA(TGAFile *sp) /* TGA structure pointer */
         {
                 printf( "Scan Line Offset                   = 0x%08x\n",
                                         sp->scanLineOffset );
-                if ( sp->scanLineTable )
+                if ( GetTGAScanLineTable( sp ) )
                 {
                         PrintScanLineTable( sp );
                 }
@@ -429,10 +489,10 @@ void PrintMonth(UINT16 month)
 void PrintScanLineTable(TGAFile *sp)
 {
         UINT16  n;
-        UINT32  *p;
+        const UINT32    *p;
 
         puts( "Scan Line Table:" );
-        p = sp->scanLineTable;
+        p = GetTGAScanLineTable( sp );
         for ( n = 0; n < sp->imageHeight; ++n )
         {
                 printf( "Scan Line %6u, Offset 0x%08x(%8u)\n", n, *p, *p );
@@ -19,12 +19,16 @@
 **
 **              -noprompt               converts old TGA to new TGA without prompting for data
 **              -nostamp                omits creation of postage stamp
+**              -stampsize n            creates a postage stamp of up to n x n pixels,
+**                                              from 1 to 255 (default 64), replacing
+**                                              any stamp the file already has
+**              -threads n              creates the postage stamp using n threads
 **              -all                    enables editing of all fields of TGA file, the
 **                                              default only processes non-critical fields.
 **              -noextend               force output file to be old TGA format
 **              -nodev                  disables copying of developer area
 **              -nocolor                disables copying of color correction table
-**              -noscan                 disables copying of scan line offset table
+**              -noscan                 disables creation of scan line offset table
 **              -version                report version number of program
 */
 
@@ -35,6 +39,7 @@
 #include <sys/stat.h>
 #include "tga.h"
 
+#include <config/file_io.h>
 #include <config/string_case_compare.h>
 
 /*
@@ -46,13 +51,11 @@
 #define WARN            1                       /* provides warning message during edit */
 #define NOWARN          0
 
-#define CBUFSIZE        2048            /* size of copy buffer */
 #define RLEBUFSIZ       512                     /* size of largest possible RLE packet */
 
 
 extern int              main( int, char ** );
-extern int              CountDiffPixels( char *, int, int );
-extern int              CountSamePixels( char *, int, int );
+extern int              CopyFileData( FILE *, long, FILE *, long );
 extern int              CreatePostageStamp( FILE *, TGAFile *, TGAFile * );
 extern int              DisplayImageData( unsigned char *, int, int );
 extern int              EditHexNumber( char *, long int, unsigned long int *, long int,
@@ -70,6 +73,7 @@ extern void             PrintMonth( UINT16 );
 extern void             PrintScanLineTable( TGAFile * );
 extern void             PrintTGAInfo( TGAFile * );
 extern char             *SkipBlank( char * );
+extern char             **SkipOptions( char ** );
 
 
 /*
@@ -135,12 +139,12 @@ int                     noColor;                /* when true, color correction t
 int                     noScan;                 /* when true, scan line table omitted */
 int                     allFields;              /* when true, enables editing of all TGA fields */
 int                     noExtend;               /* when true, output old TGA format */
+int                     stampSize;              /* width and height of postage stamp */
+int                     newStamp;               /* when true, an existing postage stamp is replaced */
+int                     threads;                /* number of threads used for postage stamp */
 
 char            rleBuf[RLEBUFSIZ];
 
-char            copyBuf[CBUFSIZE];
-
-
 char            *versionStr =
 "Truevision(R) TGA(tm) File Edit Utility Version 2.0 - March 24, 1990";
 
@@ -163,9 +167,12 @@ int main(int argc, char **argv)
         noStamp = 0;            /* default to creating postage stamp */
         noDev = 0;                      /* default to copying developer area, if present */
         noColor = 0;            /* default to copying color correction table */
-        noScan = 0;                     /* default to copying scan line offset table */
+        noScan = 0;                     /* default to creating scan line offset table */
         allFields = 0;          /* default to non-critical fields */
         noExtend = 0;           /* defalut to output new extended TGA format */
+        stampSize = 64;         /* default to a 64 x 64 postage stamp */
+        newStamp = 0;           /* default to keeping an existing postage stamp */
+        threads = 1;            /* default to creating the stamp on a single thread */
 
         /*
         ** The program can be invoked without an argument, in which case
@@ -190,7 +197,7 @@ int main(int argc, char **argv)
                 fileCount = ParseArgs( argc, argv );
                 if ( fileCount == 0 ) exit( 0 );
                 argv++;
-                while ( **argv == '-' ) argv++; 
+                argv = SkipOptions( argv );
                 strcpy( fileName, *argv );
         }
         for ( files = 0; files < fileCount; ++files )
@@ -198,7 +205,7 @@ int main(int argc, char **argv)
                 if ( files != 0 )
                 {
                         argv++;
-                        while ( **argv == '-' ) argv++; 
+                        argv = SkipOptions( argv );
                         strcpy( fileName, *argv );
                 }
                 /*
@@ -306,104 +313,87 @@ int main(int argc, char **argv)
 
 
 
+/*
+** Copy n bytes found at offset in the input file to the output file.
+** Sections that are not changed are copied within the kernel where the
+** platform allows, so editing the fields of a large image costs little
+** more than reading its header.  A short copy is an error.
+*/
+int CopyFileData(FILE *ifp, long offset, FILE *ofp, long n)
+{
+        if ( n <= 0 ) return( 0 );
+        if ( file_copy( ifp, offset, ofp, n ) != n ) return( -1 );
+        return( 0 );
+}
+
+
+
 int CreatePostageStamp(FILE *fp, TGAFile *isp, TGAFile *sp)
 {
-        int                     i;
-        int                     j;
-        int                     dx, dy;
-        int                     dxAdj;
-        int                     imageXAdj, imageYAdj;
-        int                     maxY;
-        int                     bufSize;
-        int                     bytesPerPixel;
-        int                     stampSize;
-        long int        fileOffset;
-        unsigned char   *p, *q;
-        unsigned char   *rowBuf;
+        int                     w, h;
+        int                     status;
+        long            mapSize;
+        unsigned char   *colormap;
+        TGADecoder      decoder;
 
         /*
-        ** Create a postage stamp if reasonable to do so...
-        ** Since the postage stamp size is set to 64 x 64, we
-        ** require the image to be at least twice this resolution
-        ** before it makes sense to increase the file size by 50%.
-        ** The handling of run length encoded data also represents
-        ** a more troublesome problem.
+        ** The postage stamp is stampSize pixels square, or as large as
+        ** the image allows, and each of its pixels is the average of
+        ** the image pixels it covers.  Color mapped images are averaged
+        ** through the color map, so the map is read first.
         */
-        if ( sp->imageWidth > 127 && sp->imageHeight > 127 )
+        w = sp->imageWidth < stampSize ? sp->imageWidth : stampSize;
+        h = sp->imageHeight < stampSize ? sp->imageHeight : stampSize;
+        if ( w < 1 || h < 1 )
         {
-                /*
-                ** The postage stamp is created by sampling the image data.
-                ** The adjustment values cause the samples to be taken from
-                ** the middle of the skipped range, as well as from the middle
-                ** of the image.
-                */
-                dx = sp->imageWidth >> 6;
-                dxAdj = dx >> 1;
-                imageXAdj = ( sp->imageWidth % 64 ) >> 1;
-                dy = sp->imageHeight >> 6;
-                imageYAdj = ( sp->imageHeight % 64 ) >> 1;
-                maxY = 64 * dy + imageYAdj;
-
-                bytesPerPixel = ( sp->pixelDepth + 7 ) >> 3;
-                bufSize = bytesPerPixel * sp->imageWidth;
-
-                stampSize = 64 * 64 * bytesPerPixel;
-                sp->postStamp = malloc( stampSize );
-                if ( sp->postStamp == NULL )
-                        return( -1 );
-                memset( sp->postStamp, 0, stampSize );
-                fileOffset = 18 + isp->idLength + 
-                        ((isp->mapWidth + 7) >> 3) * (long)isp->mapLength;
-                if ( fseek( fp, fileOffset, SEEK_SET ) != 0 ) return( -1 );
-
-                rowBuf = malloc( bufSize );
-                if ( rowBuf != NULL )
-                {
-                        q = sp->postStamp;
-                        for ( i = 0; i < maxY; ++i )
-                        {
-                                if ( sp->imageType > 0 && sp->imageType < 4 )
-                                {
-                                        fread( rowBuf, 1, bufSize, fp );
-                                }
-                                else if ( sp->imageType > 8 && sp->imageType < 12 )
-                                {
-                                        if ( ReadRLERow(fp, rowBuf, bufSize, bytesPerPixel) < 0 )
-                                        {
-                                                puts( "Error reading RLE data during stamp creation." );
-                                                return( -1 );
-                                        }
-                                }
-                                else
-                                {
-                                        puts( "Unknown Image Type." );
-                                        sp->stampOffset = 0;
-                                        return( -1 );
-                                }
-                                if ( i < imageYAdj || ((i - imageYAdj) % dy) ) continue;
-                                p = rowBuf + ( bytesPerPixel * (imageXAdj + dxAdj) );
-                                for ( j = 0; j < 64; ++j )
-                                {
-                                        *q++ = *p;
-                                        if ( bytesPerPixel > 1 ) *q++ = *(p + 1);
-                                        if ( bytesPerPixel > 2 ) *q++ = *(p + 2);
-                                        if ( bytesPerPixel > 3 ) *q++ = *(p + 3);
-                                        p += dx * bytesPerPixel;
-                                }
-                        }
-                        free( rowBuf );
-                        sp->stampWidth = sp->stampHeight = 64;
-                }
-                else
+                sp->postStamp = NULL;
+                sp->stampOffset = 0;
+                return( 0 );
+        }
+        colormap = NULL;
+        if ( isp->mapType != 0 && isp->mapLength > 0 )
+        {
+                mapSize = ( ( isp->mapWidth + 7 ) >> 3 ) * (long)isp->mapLength;
+                colormap = malloc( mapSize );
+                if ( colormap == NULL ||
+                                fseek( fp, 18L + isp->idLength, SEEK_SET ) != 0 ||
+                                (long)fread( colormap, 1, mapSize, fp ) != mapSize )
                 {
-                        puts( "Unable to create row buffer." );
+                        puts( "Error reading color map during stamp creation." );
+                        free( colormap );
                         return( -1 );
                 }
         }
-        else
+        if ( InitTGADecoder( &decoder, fp, isp ) < 0 )
         {
+                puts( "Unknown Image Type." );
+                FreeTGADecoder( &decoder );
+                free( colormap );
                 sp->stampOffset = 0;
+                return( -1 );
+        }
+        /*
+        ** The rows are decoded in order, so packets running on from
+        ** one scan line to the next can be followed.
+        */
+        decoder.wrapPackets = 1;
+        sp->postStamp = malloc( (size_t)w * h * decoder.bytesPerPixel );
+        if ( sp->postStamp == NULL )
+        {
+                FreeTGADecoder( &decoder );
+                free( colormap );
+                return( -1 );
+        }
+        status = CreateTGAStamp( &decoder, colormap, sp->postStamp, w, h, threads );
+        FreeTGADecoder( &decoder );
+        free( colormap );
+        if ( status < 0 )
+        {
+                puts( "Error reading image data during stamp creation." );
+                return( -1 );
         }
+        sp->stampWidth = w;
+        sp->stampHeight = h;
         return( 0 );
 }
 
@@ -861,10 +851,12 @@ int             xTGA;           flags input file as new TGA format
 int OutputTGAFile(FILE *ifp, FILE *ofp, TGAFile *isp, TGAFile *sp, struct stat *isbp)
 {
         long                    byteCount;
-        long                    imageByteCount;
         long                    fileOffset;
         int                             i;
         int                             bytesPerPixel;
+        UINT32                  *scanTable;
+        int                             omitScan;
+        TGADecoder              decoder;
 
         if ( WriteTGAFile(sp, ofp) < 0 ) return -1;
 
@@ -877,21 +869,59 @@ int OutputTGAFile(FILE *ifp, FILE *ofp, TGAFile *isp, TGAFile *sp, struct stat *
         */
         fileOffset = ftell( ofp );
         bytesPerPixel = (isp->pixelDepth + 7) >> 3;
-        if ( isp->imageType > 0 && isp->imageType < 4 )
-        {
-                byteCount = bytesPerPixel *
-                                        (long)isp->imageWidth *
-                                        (long)isp->imageHeight;
-        }
-        else if ( isp->imageType > 8 && isp->imageType < 12 )
+        scanTable = NULL;
+        omitScan = 0;
+        if ( ( isp->imageType > 0 && isp->imageType < 4 ) ||
+                 ( isp->imageType > 8 && isp->imageType < 12 ) )
         {
-                imageByteCount = CountRLEData( ifp, isp->imageWidth,
-                                isp->imageHeight, bytesPerPixel );
-                /* Recalculate offset to beginning of image data */
-                byteCount = 18 + isp->idLength;
-                byteCount += ((isp->mapWidth + 7) >> 3) * (long)isp->mapLength;
-                if ( fseek( ifp, byteCount, SEEK_SET ) != 0 ) return( -1 );
-                byteCount = imageByteCount;
+                /*
+                ** Copy the image data a packet at a time, noting where
+                ** each scan line starts so that the scan line table can
+                ** be created without another pass over the data.
+                */
+                if ( !noExtend && !noScan )
+                {
+                        scanTable = malloc( isp->imageHeight * sizeof( UINT32 ) );
+                        if ( scanTable == NULL )
+                        {
+                                puts( "Unable to allocate Scan Line Table" );
+                                return( -1 );
+                        }
+                }
+                if ( InitTGADecoder( &decoder, ifp, isp ) < 0 )
+                        byteCount = -1;
+                else
+                        byteCount = CopyTGARows( &decoder, ofp, fileOffset, scanTable );
+                FreeTGADecoder( &decoder );
+                if ( byteCount == TGA_DECODE_ERROR_BAD_PACKET && scanTable != NULL )
+                {
+                        /*
+                        ** Packets of older files may run on from one
+                        ** scan line to the next, leaving some lines
+                        ** without an offset.  Such files are copied as
+                        ** they are, but without a scan line table.
+                        */
+                        puts( "Warning: run length packets cross scan lines, scan line table omitted." );
+                        free( scanTable );
+                        scanTable = NULL;
+                        omitScan = 1;
+                        if ( fseek( ofp, fileOffset, SEEK_SET ) != 0 ||
+                                        InitTGADecoder( &decoder, ifp, isp ) < 0 )
+                                byteCount = -1;
+                        else
+                                byteCount = CopyTGARows( &decoder, ofp, fileOffset, NULL );
+                        FreeTGADecoder( &decoder );
+                }
+                if ( byteCount < 0 )
+                {
+                        if ( byteCount == TGA_DECODE_ERROR_BAD_PACKET )
+                                puts( "Run length packets run past the end of the image." );
+                        else
+                                puts( "Error copying image data." );
+                        free( scanTable );
+                        return( -1 );
+                }
+                fileOffset += byteCount;
         }
         else if ( f.extAreaOffset == 0 )
         {
@@ -903,32 +933,58 @@ int OutputTGAFile(FILE *ifp, FILE *ofp, TGAFile *isp, TGAFile *sp, struct stat *
                 byteCount = 18 + isp->idLength;
                 byteCount += ((isp->mapWidth + 7) >> 3) * (long)isp->mapLength;
                 byteCount = isbp->st_size - byteCount;
+                fileOffset += byteCount;
+                if ( CopyFileData( ifp, GetTGADataOffset( isp ), ofp, byteCount ) < 0 )
+                {
+                        puts( "Error copying image data." );
+                        return( -1 );
+                }
         }
         else
         {
                 puts( "Cannot determine amount of image data" );
                 return( -1 );
         }
-        fileOffset += byteCount;
-        while ( byteCount > 0 )
+
+        if ( noExtend ) return( 0 );
+
+        /*
+        ** Unlike the figure in the specification, we will output
+        ** the scan line table, the postage stamp, and the color
+        ** correction table before we output the extension area.
+        ** This simply makes the calculation of the offset values
+        ** easier to manage...
+        **
+        ** The scan line table is the one recorded while copying the
+        ** image data, or the input table when the data could not be
+        ** examined.
+        */
+        if ( scanTable != NULL )
         {
-                if ( byteCount - CBUFSIZE < 0 )
+                sp->scanLineOffset = fileOffset;
+                for ( i = 0; i < sp->imageHeight; ++i )
                 {
-                        fread( copyBuf, 1, (int)byteCount, ifp );
-                        if ( fwrite( copyBuf, 1, (int)byteCount, ofp ) != (int)byteCount )
+                        if ( WriteLong(ofp, scanTable[i]) < 0 )
+                        {
+                                free( scanTable );
                                 return( -1 );
+                        }
                 }
-                else
+                free( scanTable );
+                fileOffset += sp->imageHeight * sizeof( UINT32 );
+        }
+        else if ( !noScan && !omitScan && isp->scanLineOffset != 0L )
+        {
+                if ( fseek( ifp, isp->scanLineOffset, SEEK_SET ) != 0 )
+                        return( -1 );
+                sp->scanLineOffset = fileOffset;
+                for ( i = 0; i < sp->imageHeight; ++i )
                 {
-                        fread( copyBuf, 1, CBUFSIZE, ifp );
-                        if ( fwrite( copyBuf, 1, CBUFSIZE, ofp ) != CBUFSIZE )
-                                return( -1 );
+                        if ( WriteLong(ofp, ReadLong(ifp)) < 0 ) return( -1 );
                 }
-                byteCount -= CBUFSIZE;
+                fileOffset += sp->imageHeight * sizeof( UINT32 );
         }
 
-        if ( noExtend ) return( 0 );
-
         /*
         ** Attempt to preserve developer area if it exists in the input file
         */
@@ -942,30 +998,14 @@ int OutputTGAFile(FILE *ifp, FILE *ofp, TGAFile *isp, TGAFile *sp, struct stat *
                 }
                 for ( i = 0; i < sp->devTags; ++i )
                 {
-                        if ( fseek( ifp, isp->devDirs[i].tagOffset, SEEK_SET ) != 0 )
-                        {
-                                puts( "Error seeking to developer entry." );
-                                free( sp->devDirs );
-                                return( -1 );
-                        }
                         sp->devDirs[i].tagOffset = fileOffset;
                         byteCount = isp->devDirs[i].tagSize;
                         fileOffset += byteCount;
-                        while ( byteCount > 0 )
+                        if ( CopyFileData( ifp, isp->devDirs[i].tagOffset, ofp, byteCount ) < 0 )
                         {
-                                if ( byteCount - CBUFSIZE < 0 )
-                                {
-                                        fread( copyBuf, 1, (int)byteCount, ifp );
-                                        if ( fwrite( copyBuf, 1, (int)byteCount, ofp ) != (int)byteCount )
-                                                return( -1 );
-                                }
-                                else
-                                {
-                                        fread( copyBuf, 1, CBUFSIZE, ifp );
-                                        if ( fwrite( copyBuf, 1, CBUFSIZE, ofp ) != CBUFSIZE )
-                                                return( -1 );
-                                }
-                                byteCount -= CBUFSIZE;
+                                puts( "Error copying developer entry." );
+                                free( sp->devDirs );
+                                return( -1 );
                         }
                 }
                 sp->devDirOffset = fileOffset;
@@ -981,38 +1021,15 @@ int OutputTGAFile(FILE *ifp, FILE *ofp, TGAFile *isp, TGAFile *sp, struct stat *
                 free( sp->devDirs );
         }
 
-        /*
-        ** Unlike the figure in the specification, we will output
-        ** the scan line table, the postage stamp, and the color
-        ** correction table before we output the extension area.
-        ** This simply makes the calculation of the offset values
-        ** easier to manage...
-        ** Copy the scan line table from the input file to
-        ** the output file.  A future version could create the table
-        ** if it does not already exist.
-        */
-        if ( !noScan && isp->scanLineOffset != 0L )
-        {
-                if ( fseek( ifp, isp->scanLineOffset, SEEK_SET ) != 0 )
-                        return( -1 );
-                sp->scanLineOffset = fileOffset;
-                for ( i = 0; i < sp->imageHeight; ++i )
-                {
-                        if ( WriteLong(ofp, ReadLong(ifp)) < 0 ) return( -1 );
-                }
-                fileOffset += sp->imageHeight * sizeof( UINT32 );
-        }
-
         /*
         ** Either copy the postage stamp from the input file to
-        ** the output file, or create one.
+        ** the output file, or create one.  A stamp of the size
+        ** asked for with -stampsize is always created.
         */
         if ( !noStamp )
         {
-                if ( isp->stampOffset != 0 )
+                if ( isp->stampOffset != 0 && !newStamp )
                 {
-                        if ( fseek( ifp, isp->stampOffset, SEEK_SET ) != 0 )
-                                return( -1 );
                         /*
                         ** Since postage stamps are uncompressed, calculation
                         ** of its size is straight forward.
@@ -1023,21 +1040,10 @@ int OutputTGAFile(FILE *ifp, FILE *ofp, TGAFile *isp, TGAFile *sp, struct stat *
 
                         sp->stampOffset = fileOffset;
                         fileOffset += byteCount;
-                        while ( byteCount > 0 )
+                        if ( CopyFileData( ifp, isp->stampOffset, ofp, byteCount ) < 0 )
                         {
-                                if ( byteCount - CBUFSIZE < 0 )
-                                {
-                                        fread( copyBuf, 1, (int)byteCount, ifp );
-                                        if ( fwrite( copyBuf, 1, (int)byteCount, ofp ) != (int)byteCount )
-                                                return( -1 );
-                                }
-                                else
-                                {
-                                        fread( copyBuf, 1, CBUFSIZE, ifp );
-                                        if ( fwrite( copyBuf, 1, CBUFSIZE, ofp ) != CBUFSIZE )
-                                                return( -1 );
-                                }
-                                byteCount -= CBUFSIZE;
+                                puts( "Error copying postage stamp." );
+                                return( -1 );
                         }
                 }
                 else
@@ -1045,7 +1051,12 @@ int OutputTGAFile(FILE *ifp, FILE *ofp, TGAFile *isp, TGAFile *sp, struct stat *
                         if ( (isp->imageType > 0 && isp->imageType < 4 ) ||
                                  (isp->imageType > 8 && isp->imageType < 12 ) )
                         {
-                                if ( CreatePostageStamp( ifp, isp, sp ) >= 0 && sp->postStamp )
+                                if ( CreatePostageStamp( ifp, isp, sp ) < 0 )
+                                {
+                                        puts( "Error creating postage stamp." );
+                                        return( -1 );
+                                }
+                                if ( sp->postStamp != NULL )
                                 {
                                         sp->stampOffset = fileOffset;
                                         WriteByte(ofp, sp->stampWidth);
@@ -1053,20 +1064,12 @@ int OutputTGAFile(FILE *ifp, FILE *ofp, TGAFile *isp, TGAFile *sp, struct stat *
                                         i = sp->stampWidth * sp->stampHeight *
                                                 bytesPerPixel;
                                         fileOffset += i + 2;
-                                        if ( fwrite( sp->postStamp, 1, i, ofp ) != i )
+                                        if ( (int)fwrite( sp->postStamp, 1, i, ofp ) != i )
                                         {
                                                 puts( "Error writing postage stamp." );
                                                 return( -1 );
                                         }
                                 }
-                                else
-                                {
-                                        if ( sp->postStamp )
-                                                puts( "Error creating postage stamp." );
-                                        else
-                                                puts( "Image size too small for stamp" );
-                                        return( -1 );
-                                }
                         }
                         else
                         {
@@ -1079,10 +1082,10 @@ int OutputTGAFile(FILE *ifp, FILE *ofp, TGAFile *isp, TGAFile *sp, struct stat *
         /*
         ** Next copy the Color Correction Table to the output file
         */
-        if ( !noColor && sp->colorCorrectTable != NULL )
+        if ( !noColor && GetTGAColorCorrectTable( isp ) != NULL )
         {
                 sp->colorCorrectOffset = fileOffset;
-                if ( WriteColorCorrectTable(sp, ofp) < 0 ) return( -1 );
+                if ( WriteColorCorrectTable(isp, ofp) < 0 ) return( -1 );
                 fileOffset += 1024 * sizeof(UINT16);
         }
 
@@ -1151,6 +1154,19 @@ int ParseArgs(int argc, char **argv)
                         else if ( string_case_compare( p, "nodev" ) == 0 ) noDev = 1;
                         else if ( string_case_compare( p, "nocolor" ) == 0 ) noColor = 1;
                         else if ( string_case_compare( p, "noscan" ) == 0 ) noScan = 1;
+                        else if ( string_case_compare( p, "stampsize" ) == 0 && i + 1 < argc &&
+                                        atoi( argv[1] ) > 0 && atoi( argv[1] ) < 256 )
+                        {
+                                stampSize = atoi( *(++argv) );
+                                newStamp = 1;
+                                ++i;
+                        }
+                        else if ( string_case_compare( p, "threads" ) == 0 && i + 1 < argc &&
+                                        atoi( argv[1] ) > 0 )
+                        {
+                                threads = atoi( *(++argv) );
+                                ++i;
+                        }
                         else if ( string_case_compare( p, "version" ) == 0 )
                         {
                                 puts( versionStr );
@@ -1162,6 +1178,8 @@ int ParseArgs(int argc, char **argv)
                                 puts( "  where options can be:" );
                                 puts( "    -noprompt\t\tprocess without prompting for changes" );
                                 puts( "    -nostamp\t\tsuppress postage stamp" );
+                                puts( "    -stampsize n\t\tcreate postage stamp of n x n pixels" );
+                                puts( "    -threads n\t\tcreate postage stamp using n threads" );
                                 puts( "    -nodev\t\tsuppress developer area" );
                                 puts( "    -nocolor\t\tsuppress color correction table" );
                                 puts( "    -noscan\t\tsuppress scan line offset table" );
@@ -1180,10 +1198,10 @@ int ParseArgs(int argc, char **argv)
 void PrintColorTable(TGAFile *sp)
 {
         unsigned int    n;
-        UINT16                  *p;
+        const UINT16            *p;
 
         puts( "Color Correction Table:" );
-        p = sp->colorCorrectTable;
+        p = GetTGAColorCorrectTable( sp );
         for ( n = 0; n < 256; ++n )
         {
                 printf( "Color Entry %3u: 0x%04x(%5u) A, ", n, *p, *p );
@@ -1292,7 +1310,7 @@ void PrintExtendedTGA(TGAFile *sp)
         }
 
         printf( "Color Correction Offset = 0x%08x\n", sp->colorCorrectOffset );
-        if ( sp->colorCorrectOffset && sp->colorCorrectTable )
+        if ( sp->colorCorrectOffset && GetTGAColorCorrectTable( sp ) )
         {
                 PrintColorTable( sp );
         }
@@ -1303,7 +1321,7 @@ void PrintExtendedTGA(TGAFile *sp)
                                         sp->stampWidth, sp->stampHeight );
         }
         printf( "Scan Line Offset = 0x%08x\n", sp->scanLineOffset );
-        if ( sp->scanLineOffset && sp->scanLineTable )
+        if ( sp->scanLineOffset && GetTGAScanLineTable( sp ) )
         {
                 PrintScanLineTable( sp );
         }
@@ -1396,10 +1414,10 @@ void PrintMonth(UINT16 month)
 void PrintScanLineTable(TGAFile *sp)
 {
         UINT16  n;
-        UINT32  *p;
+        const UINT32    *p;
 
         puts( "Scan Line Table:" );
-        p = sp->scanLineTable;
+        p = GetTGAScanLineTable( sp );
         for ( n = 0; n < sp->imageHeight; ++n )
         {
                 printf( "Scan Line %6u, Offset 0x%08x(%8u)\n", n, *p, *p );
@@ -1460,3 +1478,21 @@ char *SkipBlank(char *p)
         while ( *p != '\0' && (*p == ' ' || *p == '\t') ) ++p;
         return( p );
 }
+
+
+
+/*
+** Step over options, and the values of options that take one, to
+** reach the next file name argument.
+*/
+char **SkipOptions(char **argv)
+{
+        while ( **argv == '-' )
+        {
+                if ( ( string_case_compare( *argv + 1, "stampsize" ) == 0 ||
+                                string_case_compare( *argv + 1, "threads" ) == 0 ) &&
+                                argv[1] != NULL ) argv++;
+                argv++;
+        }
+        return( argv );
+}
@@ -0,0 +1,140 @@
+/*
+** TGAINDEX builds a row index for each Truevision TGA(tm) File named on
+** the command line and stores it beside the image in a sidecar file
+** with the extension ".idx" appended to the image file name.
+**
+** Run length encoded images without a scan line table must otherwise be
+** decoded from the first row to find any other row.  With the index in
+** place, region and parallel decodes of the image can start at any row
+** without reading the rows before it.  The index records the size and
+** modification time of the image, and is ignored once the image changes.
+**
+** Usage: tgaindex [-check] file ...
+**
+**      -check  report whether each index is present and up to date
+**              instead of building it
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tga.h>
+
+extern int              main( int, char ** );
+extern int              CheckIndex( char *, TGADecoder * );
+extern int              IndexFile( char *, int );
+
+
+const char              *versionStr =
+"Truevision(R) TGA(tm) Row Index Utility Version 1.0";
+
+int main( int argc, char **argv )
+{
+        int                     check = 0;
+        int                     status = 0;
+
+        puts( versionStr );
+        while ( argc > 1 && argv[1][0] == '-' )
+        {
+                if ( strcmp( argv[1], "-check" ) == 0 ) check = 1;
+                else
+                {
+                        printf( "Unknown option %s\n", argv[1] );
+                        argc = 1;
+                        break;
+                }
+                argc--;
+                argv++;
+        }
+        if ( argc < 2 )
+        {
+                puts( "Usage: tgaindex [-check] file ..." );
+                exit( 1 );
+        }
+        while ( --argc > 0 )
+        {
+                if ( IndexFile( *++argv, check ) < 0 ) status = 1;
+        }
+        return( status );
+}
+
+
+/*
+** Build or check the index of a single image file.
+*/
+int IndexFile( char *fileName, int check )
+{
+        TGAFile         f;
+        TGADecoder      d;
+        FILE            *fp;
+        int                     status;
+
+        if ( ( fp = fopen( fileName, "rb" ) ) == NULL )
+        {
+                printf( "Unable to open image file %s\n", fileName );
+                return( -1 );
+        }
+        if ( ReadTGAFile( fp, &f ) < 0 )
+        {
+                printf( "Error reading image file %s\n", fileName );
+                fclose( fp );
+                return( -1 );
+        }
+        if ( InitTGADecoder( &d, fp, &f ) < 0 )
+        {
+                printf( "%s: unsupported image type\n", fileName );
+                FreeTGAFile( &f );
+                fclose( fp );
+                return( -1 );
+        }
+        if ( !d.rle )
+        {
+                printf( "%s: uncompressed, no index needed\n", fileName );
+                status = 0;
+        }
+        else if ( check ) status = CheckIndex( fileName, &d );
+        else
+        {
+                status = WriteTGAIndex( fileName, &d );
+                if ( status < 0 )
+                {
+                        if ( status == TGA_INDEX_ERROR_DECODE )
+                                printf( "%s: run length packets must not cross scan lines\n", fileName );
+                        else
+                                printf( "%s: unable to write %s%s\n", fileName, fileName, TGA_INDEX_SUFFIX );
+                }
+                else printf( "%s: indexed %u rows\n", fileName, f.imageHeight );
+        }
+        FreeTGADecoder( &d );
+        FreeTGAFile( &f );
+        fclose( fp );
+        return( status );
+}
+
+
+/*
+** Report whether the index of an image file is present and matches the
+** current version of the image.
+*/
+int CheckIndex( char *fileName, TGADecoder *dp )
+{
+        int                     status;
+
+        status = ReadTGAIndex( fileName, dp );
+        switch ( status )
+        {
+        case 0:
+                printf( "%s: index up to date\n", fileName );
+                break;
+        case TGA_INDEX_ERROR_OPEN:
+                printf( "%s: no index\n", fileName );
+                break;
+        case TGA_INDEX_ERROR_STALE:
+                printf( "%s: index out of date\n", fileName );
+                break;
+        default:
+                printf( "%s: unable to read index\n", fileName );
+                break;
+        }
+        return( status );
+}
@@ -0,0 +1,257 @@
+/*
+** TGAMIP writes reduced copies of each Truevision TGA(tm) File named on
+** the command line, at 1/2, 1/4 and 1/8 of the width and height of the
+** image by default.  Each pixel of a reduced copy is the average of the
+** image pixels it covers, and color mapped images keep their color map.
+** All of the copies are built while the image is decoded once.
+**
+** The copy at 1/n scale is written beside the image, with "_n" added to
+** its name before the extension (e.g., image_4.tga).  Copies are in the
+** original TGA format, run length encoded when the image is, and may be
+** given a postage stamp and converted to the extended format by TGAEDIT.
+**
+** Usage: tgamip [-levels n] file ...
+**
+**      -levels n       write n reduced copies, from 1 to 16 (default 3)
+*/
+
+#include <config/string_case_compare.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tga.h>
+
+extern int              main( int, char ** );
+extern int              MipFile( char *, int );
+extern int              ParseArgs( int, char ** );
+extern char             **SkipOptions( char ** );
+extern int              WriteLevel( char *, TGAFile *, unsigned char *, TGAPyramid *, int );
+
+
+int                     mipLevels;              /* number of reduced copies written */
+
+const char              *versionStr =
+"Truevision(R) TGA(tm) Pyramid Utility Version 1.0";
+
+int main( int argc, char **argv )
+{
+        int                     fileCount;
+        int                     status = 0;
+
+        mipLevels = 3;          /* default to copies at 1/2, 1/4 and 1/8 scale */
+
+        puts( versionStr );
+        fileCount = ParseArgs( argc, argv );
+        if ( fileCount == 0 )
+        {
+                puts( "Usage: tgamip [-levels n] file ..." );
+                exit( 1 );
+        }
+        argv++;
+        while ( fileCount-- > 0 )
+        {
+                argv = SkipOptions( argv );
+                if ( MipFile( *argv++, mipLevels ) < 0 ) status = 1;
+        }
+        return( status );
+}
+
+
+/*
+** Set the options given on the command line, and count the file names
+** among them.  An unknown option stops the program.
+*/
+int ParseArgs( int argc, char **argv )
+{
+        int                     i;
+        int                     n;
+        char            *p;
+
+        n = 0;
+        for ( i = 1; i < argc; ++i )
+        {
+                p = *(++argv);
+                if ( *p == '-' )
+                {
+                        p++;
+                        if ( string_case_compare( p, "levels" ) == 0 && i + 1 < argc &&
+                                        atoi( argv[1] ) > 0 && atoi( argv[1] ) <= TGA_PYRAMID_LEVELS )
+                        {
+                                mipLevels = atoi( *(++argv) );
+                                ++i;
+                        }
+                        else
+                        {
+                                printf( "Unknown option %s\n", p - 1 );
+                                puts( "Usage: tgamip [-levels n] file ..." );
+                                exit( 1 );
+                        }
+                }
+                else ++n;
+        }
+        return( n );
+}
+
+
+/*
+** Step over options, and the values of options that take one, to
+** reach the next file name argument.
+*/
+char **SkipOptions( char **argv )
+{
+        while ( **argv == '-' )
+        {
+                if ( string_case_compare( *argv + 1, "levels" ) == 0 && argv[1] != NULL ) argv++;
+                argv++;
+        }
+        return( argv );
+}
+
+
+/*
+** Build the reduced copies of a single image file and write each of
+** them to its own file.
+*/
+int MipFile( char *fileName, int levels )
+{
+        TGAFile         f;
+        TGADecoder      d;
+        TGAPyramid      pyramid;
+        FILE            *fp;
+        unsigned char   *colormap;
+        long            mapSize;
+        int                     status;
+        int                     k;
+
+        if ( ( fp = fopen( fileName, "rb" ) ) == NULL )
+        {
+                printf( "Unable to open image file %s\n", fileName );
+                return( -1 );
+        }
+        if ( ReadTGAFile( fp, &f ) < 0 )
+        {
+                printf( "Error reading image file %s\n", fileName );
+                fclose( fp );
+                return( -1 );
+        }
+
+        /*
+        ** Color mapped pixels are averaged through the color map, which
+        ** is also written to every copy.
+        */
+        colormap = NULL;
+        mapSize = 0;
+        if ( f.mapType != 0 && f.mapLength > 0 )
+        {
+                mapSize = ( ( f.mapWidth + 7 ) >> 3 ) * (long)f.mapLength;
+                colormap = malloc( mapSize );
+                if ( colormap == NULL ||
+                                fseek( fp, 18L + f.idLength, SEEK_SET ) != 0 ||
+                                (long)fread( colormap, 1, mapSize, fp ) != mapSize )
+                {
+                        printf( "%s: unable to read color map\n", fileName );
+                        free( colormap );
+                        FreeTGAFile( &f );
+                        fclose( fp );
+                        return( -1 );
+                }
+        }
+        if ( InitTGADecoder( &d, fp, &f ) < 0 )
+        {
+                printf( "%s: unsupported image type\n", fileName );
+                free( colormap );
+                FreeTGAFile( &f );
+                fclose( fp );
+                return( -1 );
+        }
+        status = CreateTGAPyramid( &d, colormap, &pyramid, levels );
+        if ( status < 0 )
+        {
+                if ( status == TGA_STAMP_ERROR_READ )
+                        printf( "%s: error reading image data\n", fileName );
+                else
+                        printf( "%s: unable to reduce image\n", fileName );
+        }
+        for ( k = 0; k < pyramid.levels && status == 0; ++k )
+        {
+                status = WriteLevel( fileName, &f, colormap, &pyramid, k );
+        }
+        FreeTGAPyramid( &pyramid );
+        FreeTGADecoder( &d );
+        free( colormap );
+        FreeTGAFile( &f );
+        fclose( fp );
+        return( status );
+}
+
+
+/*
+** Write one level of the pyramid as a file of its own, with the header
+** of the image apart from its size.
+*/
+int WriteLevel( char *fileName, TGAFile *sp, unsigned char *colormap, TGAPyramid *pp, int k )
+{
+        TGAFile         lf;
+        FILE            *ofp;
+        char            *levelName;
+        char            *ext;
+        char            *packBuf;
+        unsigned char   *p;
+        long            mapSize;
+        long            rowBytes;
+        int                     bytesPerPixel;
+        int                     rle;
+        int                     y;
+        int                     n;
+        int                     status = 0;
+
+        /*
+        ** The scale is added before the extension of the image name,
+        ** if it has one.
+        */
+        levelName = malloc( strlen( fileName ) + 16 );
+        if ( levelName == NULL ) return( -1 );
+        strcpy( levelName, fileName );
+        ext = strrchr( levelName, '.' );
+        if ( ext == NULL || strchr( ext, '/' ) != NULL || strchr( ext, '\\' ) != NULL )
+                ext = levelName + strlen( levelName );
+        sprintf( ext, "_%ld%s", 2L << k, fileName + ( ext - levelName ) );
+
+        bytesPerPixel = ( sp->pixelDepth + 7 ) >> 3;
+        rowBytes = (long)pp->width[k] * bytesPerPixel;
+        rle = sp->imageType > 8;
+        packBuf = rle ? malloc( rowBytes + pp->width[k] + 1 ) : NULL;
+        if ( ( ofp = fopen( levelName, "wb" ) ) == NULL || ( rle && packBuf == NULL ) )
+        {
+                printf( "Unable to create %s\n", levelName );
+                if ( ofp != NULL ) fclose( ofp );
+                free( packBuf );
+                free( levelName );
+                return( -1 );
+        }
+
+        memcpy( &lf, sp, sizeof( TGAFile ) );
+        lf.imageWidth = (UINT16)pp->width[k];
+        lf.imageHeight = (UINT16)pp->height[k];
+        mapSize = colormap ? ( ( sp->mapWidth + 7 ) >> 3 ) * (long)sp->mapLength : 0;
+        if ( WriteTGAFile( &lf, ofp ) < 0 ||
+                        ( mapSize && (long)fwrite( colormap, 1, mapSize, ofp ) != mapSize ) )
+                status = -1;
+        p = pp->pixels[k];
+        for ( y = 0; y < pp->height[k] && status == 0; ++y, p += rowBytes )
+        {
+                if ( rle )
+                {
+                        n = RLEncodeRow( (char *)p, packBuf, pp->width[k], bytesPerPixel );
+                        if ( (int)fwrite( packBuf, 1, n, ofp ) != n ) status = -1;
+                }
+                else if ( (long)fwrite( p, 1, rowBytes, ofp ) != rowBytes ) status = -1;
+        }
+        if ( fclose( ofp ) != 0 ) status = -1;
+        if ( status < 0 ) printf( "Error writing %s\n", levelName );
+        else printf( "%s: %d x %d\n", levelName, pp->width[k], pp->height[k] );
+        free( packBuf );
+        free( levelName );
+        return( status );
+}
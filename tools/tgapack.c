@@ -22,11 +22,34 @@
 ** Recognized options are:
 **
 **              -unpack                 uncompressed a run length encoded image
-**              -32to24                 compress a 32 bit image by eliminating alpha data
+**              -repack                 re-encode a run length encoded image whose
+**                                      packets wrap across scan lines
+**              -32to24                 compress a 32 bit image by eliminating alpha data,
+**                                      keeping run length encoded images encoded
+**              -expand                 convert a color mapped image to true color, keeping
+**                                      run length encoded images encoded unless unpacking
+**              -16to24                 convert a 16 bit true color image to 24 bit, keeping
+**                                      run length encoded images encoded unless unpacking
+**              -16to32                 as -16to24, giving 32 bit pixels with alpha data
+**                                      from the attribute bit
+**              -to16                   convert a 24 or 32 bit true color image to 16 bit,
+**                                      keeping run length encoded images encoded unless
+**                                      unpacking
+**              -dither                 dither the colors of images converted to 16 bit
+**              -correct                apply the color correction table and gamma value
+**                                      of the extension area to the image data
+**              -optimal                encode each scan line in the fewest bytes possible
+**              -auto                   leave images alone when compression does not pay off
+**              -threads n              compress or uncompress image data using n threads
+**              -j n                    process n files at a time
+**              -i file                 read a single image from file, or stdin for -
+**              -o file                 write the result to file, or stdout for -
 **              -version                report version number of program
 */
 
+#include <config/file_io.h>
 #include <config/string_case_compare.h>
+#include <config/thread.h>
 
 #include <tga.h>
 #include <stdio.h>
@@ -40,19 +63,57 @@
 ** versions of the TGA specification.
 */
 #define EXT_SIZE_20     495                     /* verison 2.0 extension size */
+#define SAMPLE_ROWS     64                      /* rows encoded to estimate the packed size */
 
-#define CBUFSIZE        2048            /* size of copy buffer */
-#define RLEBUFSIZ       512                     /* size of largest possible RLE packet */
+/*
+** State of a single file being processed, kept apart from the state
+** of other files so that several files can be processed at once.
+*/
+typedef struct _PackJob
+{
+        const char      *name;          /* file name as given */
+        char            *fileName;      /* file name searched for or found */
+        int             found;          /* non-zero if the file was found */
+        int             status;         /* 0 if the file was processed */
+        const char      *message;       /* reason the file was not processed */
+        long            inSize;         /* size of the input file in bytes */
+        long            outSize;        /* size of the output file in bytes */
+        int             keep;           /* copy the image data without compressing it */
+} PackJob;
+
+/*
+** Files shared by the threads of a batch.  Each thread takes the next
+** file waiting whenever it finishes one, so a thread that draws small
+** files simply takes more of them.
+*/
+typedef struct _PackQueue
+{
+        PackJob         *jobs;          /* all files of the batch */
+        int             count;          /* number of files */
+        int             next;           /* next file waiting */
+        int             done;           /* number of files finished */
+        int             failed;         /* number of files not processed */
+        long long       inTotal;        /* bytes read from files processed */
+        long long       outTotal;       /* bytes written for files processed */
+        thread_mutex    mutex;          /* guards all of the above */
+} PackQueue;
 
 
 extern int      main( int, char ** );
 extern int      DisplayImageData( unsigned char *, int, int );
-extern int      OutputTGAFile( FILE *, FILE *, TGAFile * );
+extern int      FindTGAFile( PackJob *, struct stat * );
+extern int      OutputTGAFile( FILE *, FILE *, TGAFile *, PackJob * );
+extern int      PackFile( PackJob * );
+extern void     PackWorker( void * );
 extern int      ParseArgs( int, char ** );
 extern void     PrintImageType( int );
 extern void     PrintTGAInfo( TGAFile * );
+extern void     ReportFile( PackJob * );
+extern void     RunBatch( PackJob *, int );
 extern char     *SkipBlank( char * );
-extern void     StripAlpha( unsigned char *, int );
+extern char     **SkipOptions( char ** );
+extern int      StreamFile( void );
+extern int      WorthPacking( FILE *, TGAFile * );
 
 
 /*
@@ -90,17 +151,20 @@ char    *extNames[] =
         NULL
 };
 
-TGAFile                 f;                              /* control structure of image data */
-
 int                             unPack;                 /* when true, uncompress image data */
+int                             rePack;                 /* when true, re-encode compressed image data */
 int                             noAlpha;                /* when true, converts 32 bit image to 24 */
-
-int                             inRawPacket;    /* flags processing state for RLE data */
-int                             inRLEPacket;    /* flags processing state for RLE data */
-unsigned int    packetSize;     /* records current RLE packet size in bytes */
-char                    rleBuf[RLEBUFSIZ];
-
-char            copyBuf[CBUFSIZE];
+int                             expandMap;              /* when true, converts color mapped image to true color */
+int                             widenTo;                /* depth 16 bit images are converted to, or 0 */
+int                             narrow;                 /* when true, converts 24 and 32 bit images to 16 */
+int                             dither;                 /* when true, dithers images converted to 16 bit */
+int                             correct;                /* when true, applies color correction to image data */
+int                             optimal;                /* when true, find the smallest encoding */
+int                             autoPack;               /* when true, only compress if it pays off */
+int                             threads;                /* number of threads used for compression */
+int                             batch;                  /* number of files processed at a time */
+char                    *inName;                /* input of stream mode, - for stdin */
+char                    *outName;               /* output of stream mode, - for stdout */
 
 
 char            *versionStr =
@@ -109,21 +173,25 @@ char            *versionStr =
 
 int main(int argc, char **argv)
 {
-        int                     fileFound;
         int                     fileCount;
         int                     files;
-        char            *q;
-        FILE            *fp, *outFile;
-        int                     i;
+        PackJob         *jobs;
         char            fileName[80];
-        char            outFileName[80];
-        struct stat     statbuf;
 
         unPack = 0;                     /* default to compressing image data */
+        rePack = 0;                     /* default to leaving compressed images alone */
         noAlpha = 0;            /* default to retaining all components of 32 bit */
+        expandMap = 0;          /* default to keeping color mapped images mapped */
+        widenTo = 0;            /* default to keeping the depth of 16 bit images */
+        narrow = 0;                     /* default to keeping the depth of 24 and 32 bit images */
+        dither = 0;                     /* default to cutting colors to 16 bit undithered */
+        correct = 0;            /* default to leaving colors as stored */
+        optimal = 0;            /* default to the faster greedy encoding */
+        autoPack = 0;           /* default to compressing every image */
+        threads = 1;            /* default to compressing on a single thread */
+        batch = 1;                      /* default to processing one file at a time */
+        inName = outName = NULL;        /* default to replacing each file named */
 
-        inRawPacket = inRLEPacket = 0;  /* initialize RLE processing flags */
-        packetSize = 0;
         /*
         ** The program can be invoked without an argument, in which case
         ** the user will be prompted for the name of the image file to be
@@ -145,109 +213,398 @@ int main(int argc, char **argv)
         else
         {
                 fileCount = ParseArgs( argc, argv );
+                if ( inName != NULL || outName != NULL )
+                {
+                        /*
+                        ** Stream mode converts a single image from input to
+                        ** output without a temporary file.
+                        */
+                        if ( fileCount != 0 )
+                        {
+                                fputs( "File names cannot be combined with -i or -o.\n", stderr );
+                                exit( 1 );
+                        }
+                        return( StreamFile() < 0 ? 1 : 0 );
+                }
                 if ( fileCount == 0 ) exit( 0 );
                 argv++;
-                while ( **argv == '-' ) argv++; 
-                strcpy( fileName, *argv );
+        }
+        jobs = calloc( fileCount, sizeof( PackJob ) );
+        if ( jobs == NULL )
+        {
+                puts( "Unable to allocate file list." );
+                exit( 1 );
         }
         for ( files = 0; files < fileCount; ++files )
         {
-                if ( files != 0 )
+                if ( argc == 1 ) jobs[files].name = fileName;
+                else
                 {
-                        argv++;
-                        while ( **argv == '-' ) argv++; 
-                        strcpy( fileName, *argv );
+                        argv = SkipOptions( argv );
+                        jobs[files].name = *argv++;
                 }
+        }
+        if ( batch > 1 && fileCount > 1 ) RunBatch( jobs, fileCount );
+        else
+        {
+                for ( files = 0; files < fileCount; ++files )
+                {
+                        PackFile( &jobs[files] );
+                        ReportFile( &jobs[files] );
+                        free( jobs[files].fileName );
+                }
+        }
+        free( jobs );
+        return 0;
+}
+
+
+
+/*
+** See if we can find the file as specified or with one of the
+** standard filename extensions.  If not, the file name is left
+** without any extension tried.
+*/
+int FindTGAFile(PackJob *jp, struct stat *sbp)
+{
+        char            *q;
+        int                     i;
+
+        jp->fileName = malloc( strlen( jp->name ) + 5 );
+        if ( jp->fileName == NULL ) return( 0 );
+        strcpy( jp->fileName, jp->name );
+        if ( stat( jp->fileName, sbp ) == 0 ) return( 1 );
+        /*
+        ** If there is already an extension specified, skip
+        ** the search for standard extensions
+        */
+        if ( strchr( jp->fileName, '.' ) != NULL ) return( 0 );
+        q = jp->fileName + strlen( jp->fileName );
+        for ( i = 0; extNames[i] != NULL; ++i )
+        {
+                strcpy( q, extNames[i] );
+                if ( stat( jp->fileName, sbp ) == 0 ) return( 1 );
+        }
+        *q = '\0';
+        return( 0 );
+}
+
+
+
+/*
+** Compress or uncompress a single file, replacing it with the output
+** file when successful.  Nothing is printed, so that files processed
+** at the same time do not mix their messages; the outcome is left in
+** the job for ReportFile.
+*/
+int PackFile(PackJob *jp)
+{
+        TGAFile         f;
+        FILE            *fp, *outFile;
+        char            *outFileName;
+        struct stat     statbuf;
+        int                     i;
+        long            dataSize;
+
+        jp->status = -1;
+        jp->found = FindTGAFile( jp, &statbuf );
+        if ( !jp->found ) return( -1 );
+        jp->inSize = (long) statbuf.st_size;
+
+        fp = fopen( jp->fileName, "rb" );
+        if ( fp == NULL || ReadTGAFile( fp, &f ) < 0 )
+        {
+                jp->message = "Error reading input file.";
+                if ( fp != NULL )
+                {
+                        FreeTGAFile( &f );
+                        fclose( fp );
+                }
+                return( -1 );
+        }
+        if ( f.extAreaOffset != 0L && !WorthPacking( fp, &f ) )
+        {
+                jp->message = "Compression would not reduce the image size, file left unchanged.";
+                jp->outSize = jp->inSize;
+                jp->status = 0;
+        }
+        else if ( f.extAreaOffset != 0L )
+        {
                 /*
-                ** See if we can find the file as specified or with one of the
-                ** standard filename extensions...
+                ** Reset offset values since this is not a new TGA file
                 */
-                fileFound = 0;
-                if ( stat( fileName, &statbuf ) == 0 ) fileFound = 1;
+                f.extAreaOffset = 0L;
+                f.devDirOffset = 0L;
+                i = strlen( jp->fileName );
+                outFileName = malloc( i + 1 );
+                if ( outFileName == NULL )
+                {
+                        jp->message = "Unable to create output file.";
+                }
                 else
                 {
-                        /*
-                        ** If there is already an extension specified, skip
-                        ** the search for standard extensions
-                        */
-                        q = strchr( fileName, '.' );
-                        if ( q != NULL )
-                        {
-                                q = fileName + strlen( fileName );
-                        }
-                        else
+                        strcpy( outFileName, jp->fileName );
+                        outFileName[ i - 3 ] = '\0';    /* remove extension */
+                        strcat( outFileName, "$$$" );
+                        outFile = fopen( outFileName, "wb" );
+                        if ( outFile != NULL )
                         {
-                                i = 0;
-                                strcat( fileName, extNames[i] );
-                                q = strchr( fileName, '.' );
-                                while ( extNames[i] != NULL )
+                                dataSize = (long) f.imageWidth * f.imageHeight *
+                                                ( ( f.pixelDepth + 7 ) >> 3 );
+                                if ( OutputTGAFile( fp, outFile, &f, jp ) < 0 )
                                 {
-                                        strcpy( q, extNames[i] );
-                                        if ( stat( fileName, &statbuf ) == 0 )
-                                        {
-                                                fileFound = 1;
-                                                break;
-                                        }
-                                        ++i;
+                                        fclose( outFile );
+                                        remove( outFileName );
                                 }
-                        }
-                }
-                if ( fileFound )
-                {
-                        int readStatus;
-                        printf( "Processing TGA File: %s\n", fileName );
-                        fp = fopen( fileName, "rb" );
-                        readStatus = ReadTGAFile( fp, &f );
-                        if ( readStatus >= 0 )
-                        {
-                                if ( f.extAreaOffset != 0L )
+                                else if ( autoPack && !unPack && !rePack && !noAlpha && !expandMap && !widenTo && !narrow && !correct &&
+                                                ftell( outFile ) - GetTGADataOffset( &f ) >= dataSize )
                                 {
                                         /*
-                                        ** Reset offset values since this is not a new TGA file
+                                        ** The estimate was wrong, so the
+                                        ** compressed copy is discarded.
                                         */
-                                        f.extAreaOffset = 0L;
-                                        f.devDirOffset = 0L;
-                                        strcpy( outFileName, fileName );
-                                        i = strlen( fileName );
-                                        outFileName[ i - 3 ] = '\0';    /* remove extension */
-                                        strcat( outFileName, "$$$" );
-                                        outFile = fopen( outFileName, "wb" );
-                                        if ( outFile != NULL )
-                                        {
-                                                if ( OutputTGAFile( fp, outFile, &f ) < 0 )
-                                                {
-                                                        fclose( outFile );
-                                                        remove( outFileName );
-                                                }
-                                                else
-                                                {
-                                                        fclose( outFile );
-                                                        fclose( fp );
-                                                        fp = (FILE *)0;
-                                                        remove( fileName );
-                                                        rename( outFileName, fileName );
-                                                }
-                                        }
-                                        else
-                                        {
-                                                puts( "Unable to create output file." );
-                                        }
+                                        jp->message = "Compression did not reduce the image size, file left unchanged.";
+                                        jp->outSize = jp->inSize;
+                                        fclose( outFile );
+                                        remove( outFileName );
+                                        jp->status = 0;
+                                }
+                                else
+                                {
+                                        jp->outSize = ftell( outFile );
+                                        fclose( outFile );
+                                        fclose( fp );
+                                        fp = (FILE *)0;
+                                        remove( jp->fileName );
+                                        rename( outFileName, jp->fileName );
+                                        jp->status = 0;
                                 }
-                                else puts( "Input file must be original TGA format." );
                         }
                         else
                         {
-                                puts( "Error reading input file." );
+                                jp->message = "Unable to create output file.";
                         }
-                        if ( fp != NULL ) fclose( fp );
+                        free( outFileName );
                 }
+        }
+        else jp->message = "Input file must be original TGA format.";
+        FreeTGAFile( &f );
+        if ( fp != NULL ) fclose( fp );
+        return( jp->status );
+}
+
+
+
+/*
+** Print the outcome of processing a file.
+*/
+void ReportFile(PackJob *jp)
+{
+        if ( jp->found )
+        {
+                printf( "Processing TGA File: %s\n", jp->fileName );
+                if ( jp->message != NULL ) puts( jp->message );
+        }
+        else
+        {
+                printf("Unable to open image file %s\n",
+                        jp->fileName != NULL ? jp->fileName : jp->name );
+        }
+}
+
+
+
+/*
+** Convert a single image from the input to the output named with -i and
+** -o, either of which may be - for stdin or stdout.  The input is read
+** strictly in order, so it may be a pipe, and only the header, color
+** map and image data are copied; anything following the image data is
+** discarded.  Messages go to stderr, since stdout may carry the image.
+*/
+int StreamFile(void)
+{
+        TGAFile         f;
+        PackJob         job;
+        FILE            *ifp, *ofp;
+        char            drain[4096];
+        int                     status;
+
+        memset( &job, 0, sizeof( job ) );
+        if ( inName == NULL ) inName = "-";
+        if ( outName == NULL ) outName = "-";
+        if ( strcmp( inName, "-" ) == 0 )
+        {
+                ifp = stdin;
+                file_set_binary( ifp );
+        }
+        else ifp = fopen( inName, "rb" );
+        if ( ifp == NULL )
+        {
+                fprintf( stderr, "Unable to open image file %s\n", inName );
+                return( -1 );
+        }
+        if ( strcmp( outName, "-" ) == 0 )
+        {
+                ofp = stdout;
+                file_set_binary( ofp );
+        }
+        else ofp = fopen( outName, "wb" );
+        if ( ofp == NULL )
+        {
+                fputs( "Unable to create output file.\n", stderr );
+                if ( ifp != stdin ) fclose( ifp );
+                return( -1 );
+        }
+        status = ReadTGAHeader( ifp, &f );
+        if ( status < 0 ) job.message = "Error reading input file.";
+        else
+        {
+                /*
+                ** The output cannot be withdrawn once written, so an
+                ** image that would not shrink is passed on uncompressed.
+                */
+                job.keep = !WorthPacking( ifp, &f );
+                if ( job.keep )
+                        fputs( "Compression would not reduce the image size, image data left uncompressed.\n", stderr );
+                status = OutputTGAFile( ifp, ofp, &f, &job );
+        }
+        if ( ifp != stdin ) fclose( ifp );
+        else if ( status == 0 )
+        {
+                /*
+                ** Consume anything following the image data, such as an
+                ** extension area, so the program writing to the pipe is
+                ** not cut off.
+                */
+                while ( fread( drain, 1, sizeof( drain ), ifp ) > 0 ) ;
+        }
+        if ( ( ofp == stdout ? fflush( ofp ) : fclose( ofp ) ) != 0 && status == 0 )
+        {
+                job.message = "Error writing output file.";
+                status = -1;
+        }
+        if ( status < 0 )
+        {
+                fprintf( stderr, "%s\n", job.message != NULL ? job.message : "Error processing image." );
+                if ( ofp != stdout ) remove( outName );
+        }
+        return( status );
+}
+
+
+
+/*
+** Decide whether an image should be processed.  With -auto, compressing
+** an uncompressed image is only worthwhile if a sample of its rows
+** shrinks when encoded.  An image that cannot be sampled, such as one
+** read from a pipe, is always compressed.
+*/
+int WorthPacking(FILE *ifp, TGAFile *sp)
+{
+        TGADecoder      decoder;
+        long            estimate;
+        long            dataSize;
+
+        if ( !autoPack || unPack || rePack || noAlpha || expandMap || widenTo || narrow || correct ||
+                        sp->imageType < 1 || sp->imageType > 3 ) return( 1 );
+        if ( InitTGADecoder( &decoder, ifp, sp ) < 0 )
+        {
+                FreeTGADecoder( &decoder );
+                return( 1 );
+        }
+        dataSize = decoder.rowBytes * sp->imageHeight;
+        estimate = EstimateTGAEncodedSize( &decoder, SAMPLE_ROWS,
+                        optimal ? TGA_ENCODE_OPTIMAL : 0 );
+        FreeTGADecoder( &decoder );
+        return( estimate < 0 || estimate < dataSize );
+}
+
+
+
+/*
+** Process the files of a batch on the requested number of threads,
+** reporting each file as it finishes and a summary at the end.  The
+** calling thread takes files along with the threads it starts, and
+** carries on alone if no threads can be started.
+*/
+void RunBatch(PackJob *jobs, int count)
+{
+        PackQueue       queue;
+        thread_handle   *workers;
+        int                     started;
+        int                     i;
+
+        memset( &queue, 0, sizeof( queue ) );
+        queue.jobs = jobs;
+        queue.count = count;
+        if ( thread_mutex_create( &queue.mutex ) < 0 )
+        {
+                puts( "Unable to create batch, processing files one at a time." );
+                batch = 1;
+                for ( i = 0; i < count; ++i )
+                {
+                        PackFile( &jobs[i] );
+                        ReportFile( &jobs[i] );
+                        free( jobs[i].fileName );
+                }
+                return;
+        }
+        if ( batch > count ) batch = count;
+        workers = malloc( ( batch - 1 ) * sizeof( thread_handle ) );
+        started = 0;
+        while ( workers != NULL && started < batch - 1 &&
+                        thread_start( &workers[started], PackWorker, &queue ) == 0 )
+        {
+                ++started;
+        }
+        PackWorker( &queue );
+        for ( i = 0; i < started; ++i ) thread_join( workers[i] );
+        free( workers );
+        thread_mutex_destroy( queue.mutex );
+
+        printf( "%d files processed on %d threads, %d failed\n",
+                count - queue.failed, started + 1, queue.failed );
+        if ( queue.inTotal > 0 )
+        {
+                printf( "%lld bytes read, %lld bytes written (%.1f%%)\n",
+                        queue.inTotal, queue.outTotal,
+                        100.0 * (double) queue.outTotal / (double) queue.inTotal );
+        }
+}
+
+
+
+/*
+** Take files from the batch until none are left.
+*/
+void PackWorker(void *arg)
+{
+        PackQueue       *qp = arg;
+        PackJob         *jp;
+
+        for ( ;; )
+        {
+                thread_mutex_lock( qp->mutex );
+                jp = qp->next < qp->count ? &qp->jobs[qp->next++] : NULL;
+                thread_mutex_unlock( qp->mutex );
+                if ( jp == NULL ) break;
+
+                PackFile( jp );
+
+                thread_mutex_lock( qp->mutex );
+                qp->done++;
+                printf( "[%d/%d] ", qp->done, qp->count );
+                ReportFile( jp );
+                if ( jp->status < 0 ) qp->failed++;
                 else
                 {
-                        *q = '\0';
-                        printf("Unable to open image file %s\n", fileName );
+                        qp->inTotal += jp->inSize;
+                        qp->outTotal += jp->outSize;
                 }
+                thread_mutex_unlock( qp->mutex );
+                free( jp->fileName );
+                jp->fileName = NULL;
         }
-        return 0;
 }
 
 
@@ -306,15 +663,30 @@ int DisplayImageData(unsigned char *q, int n, int bpp)
 
 int OutputTGAFile(FILE *ifp, /* input file pointer */
     FILE *ofp,               /* output file pointer */
-    TGAFile *sp)             /* output TGA structure */
+    TGAFile *sp,             /* output TGA structure */
+    PackJob *jp)             /* file being processed */
 {
         long            byteCount;
         int             i;
-        int             bytesPerPixel;
+        int             narrowFlags;
+        long            mapSize;
         int             bCount;
-        int             rleCount;
         unsigned char   *imageBuff;
-        unsigned char *packBuff;
+        unsigned char   *image;
+        unsigned char   *p;
+        unsigned char   *colormap;
+        char            *packBuff;
+        TGAFile         isf;
+        TGADecoder      decoder;
+
+        /*
+        ** Keep a copy of the input description for decoding the
+        ** image data, since the output description is altered below.
+        ** A color correction table is read first, so that the copy
+        ** shares it and it is released along with the original.
+        */
+        if ( correct ) GetTGAColorCorrectTable( sp );
+        isf = *sp;
 
         /*
         ** First, we need to determine what operation is to be performed.
@@ -324,17 +696,69 @@ int OutputTGAFile(FILE *ifp, /* input file pointer */
         */
         if ( noAlpha )
         {
-            if ( sp->pixelDepth != 32 || sp->imageType != 2 )
+            if ( sp->pixelDepth != 32 || ( sp->imageType != 2 && sp->imageType != 10 ) )
             {
-                puts( "Image file must be in 32 bit uncompressed format." );
+                jp->message = "Image file must be in 32 bit true color format.";
                 return -1;
             }
             sp->pixelDepth = 24;
             sp->imageDesc &= 0xf0;
         }
-        else if ( !unPack && sp->imageType > 0 && sp->imageType < 4 )
+        else if ( expandMap )
         {
-            sp->imageType += 8;
+            if ( sp->mapType != 1 || ( sp->imageType != 1 && sp->imageType != 9 ) ||
+                            sp->mapWidth < 15 || sp->mapWidth > 32 )
+            {
+                jp->message = "Image file must be in color mapped format.";
+                return -1;
+            }
+            /*
+            ** Entries with alpha data give 32 bit pixels, and the
+            ** color map is dropped.
+            */
+            sp->imageType = ( sp->imageType == 9 && !unPack ) ? 10 : 2;
+            sp->pixelDepth = sp->mapWidth == 32 ? 32 : 24;
+            sp->imageDesc = ( sp->imageDesc & 0xf0 ) | ( sp->mapWidth == 32 ? 8 : 0 );
+            sp->mapType = 0;
+            sp->mapOrigin = sp->mapLength = 0;
+            sp->mapWidth = 0;
+        }
+        else if ( widenTo )
+        {
+            if ( ( sp->pixelDepth != 15 && sp->pixelDepth != 16 ) ||
+                            ( sp->imageType != 2 && sp->imageType != 10 ) )
+            {
+                jp->message = "Image file must be in 16 bit true color format.";
+                return -1;
+            }
+            sp->imageType = ( sp->imageType == 10 && !unPack ) ? 10 : 2;
+            sp->pixelDepth = widenTo;
+            sp->imageDesc = ( sp->imageDesc & 0xf0 ) | ( widenTo == 32 ? 8 : 0 );
+        }
+        else if ( narrow )
+        {
+            if ( ( sp->pixelDepth != 24 && sp->pixelDepth != 32 ) ||
+                            ( sp->imageType != 2 && sp->imageType != 10 ) )
+            {
+                jp->message = "Image file must be in 24 or 32 bit true color format.";
+                return -1;
+            }
+            /*
+            ** Alpha data is kept in the attribute bit of each pixel.
+            */
+            sp->imageType = ( sp->imageType == 10 && !unPack ) ? 10 : 2;
+            sp->imageDesc = ( sp->imageDesc & 0xf0 ) | ( sp->pixelDepth == 32 ? 1 : 0 );
+            sp->pixelDepth = 16;
+        }
+        else if ( rePack && sp->imageType > 8 && sp->imageType < 12 )
+        {
+            /*
+            ** The image type is unchanged; only the packets are.
+            */
+        }
+        else if ( !rePack && !unPack && sp->imageType > 0 && sp->imageType < 4 )
+        {
+            if ( !jp->keep ) sp->imageType += 8;
         }
         else if ( unPack && sp->imageType > 8 && sp->imageType < 12 )
         {
@@ -342,7 +766,7 @@ int OutputTGAFile(FILE *ifp, /* input file pointer */
         }
         else
         {
-            puts( "File type is inconsistent with requested operation." );
+            jp->message = "File type is inconsistent with requested operation.";
             return -1;
         }
         if (WriteTGAFile(sp, ofp))
@@ -350,92 +774,218 @@ int OutputTGAFile(FILE *ifp, /* input file pointer */
             return -1;
         }
 
-        if ( CopyTGAColormap(sp, ifp, ofp) < 0 ) return -1;
+        /*
+        ** An expanded color map is read for the decoder instead of
+        ** being copied.
+        */
+        colormap = NULL;
+        if ( expandMap )
+        {
+                mapSize = ( ( isf.mapWidth + 7 ) >> 3 ) * (long)isf.mapLength;
+                colormap = malloc( mapSize );
+                if ( colormap == NULL ||
+                                ( fseek( ifp, 18L + isf.idLength, SEEK_SET ) != 0 && ftell( ifp ) >= 0 ) ||
+                                (long)fread( colormap, 1, mapSize, ifp ) != mapSize )
+                {
+                        jp->message = "Error reading color map.";
+                        free( colormap );
+                        return( -1 );
+                }
+        }
+        else if ( CopyTGAColormap(sp, ifp, ofp) < 0 ) return -1;
 
         /*
         ** Now process the image data.
         */
-        bytesPerPixel = (sp->pixelDepth + 7) >> 3;
-        bCount = sp->imageWidth * bytesPerPixel;
+        if ( InitTGADecoder( &decoder, ifp, &isf ) < 0 )
+        {
+                jp->message = "Unable to decode image data.";
+                FreeTGADecoder( &decoder );
+                return( -1 );
+        }
+        decoder.wrapPackets = rePack;
+        if ( colormap != NULL )
+        {
+                i = ExpandTGAColormap( &decoder, colormap, ( sp->pixelDepth + 7 ) >> 3 );
+                free( colormap );
+                if ( i < 0 )
+                {
+                        jp->message = "Unable to expand color map.";
+                        FreeTGADecoder( &decoder );
+                        return( -1 );
+                }
+        }
+        if ( widenTo && SetTGADecodeFormat( &decoder, widenTo >> 3 ) < 0 )
+        {
+                jp->message = "Unable to widen image data.";
+                FreeTGADecoder( &decoder );
+                return( -1 );
+        }
+        if ( correct && SetTGAColorCorrection( &decoder, TGA_CORRECT_TABLE | TGA_CORRECT_GAMMA ) < 0 )
+        {
+                jp->message = "Color correction needs 24 or 32 bit pixels.";
+                FreeTGADecoder( &decoder );
+                return( -1 );
+        }
+        narrowFlags = ( isf.pixelDepth == 24 ? TGA_CONVERT_NO_ALPHA : 0 ) |
+                        ( dither ? TGA_CONVERT_DITHER : 0 );
+        bCount = decoder.rowBytes;
         imageBuff = malloc( bCount );
         if ( imageBuff == NULL )
         {
-                puts( "Unable to allocate image buffer" );
+                jp->message = "Unable to allocate image buffer";
+                FreeTGADecoder( &decoder );
                 return( -1 );
         }
 
         if ( noAlpha )
         {
+                /*
+                ** Each row is decoded, stripped of its alpha data in
+                ** place and, for a compressed image, compressed again,
+                ** so the image is converted in a single pass.
+                */
+                packBuff = NULL;
+                if ( sp->imageType == 10 )
+                {
+                        packBuff = malloc( sp->imageWidth * 4 );
+                        if ( packBuff == NULL )
+                        {
+                                jp->message = "Unable to allocate image buffer";
+                                free( imageBuff );
+                                FreeTGADecoder( &decoder );
+                                return( -1 );
+                        }
+                }
                 for ( i = 0; i < sp->imageHeight; ++i )
                 {
-                        if ( fread( imageBuff, 1, bCount, ifp ) != bCount )
+                        if ( DecodeTGARow( &decoder, imageBuff ) < 0 )
                         {
-                                puts( "Error reading uncompressed data." );
+                                jp->message = packBuff ? "Error reading RLE data." :
+                                        "Error reading uncompressed data.";
+                                free( packBuff );
                                 free( imageBuff );
+                                FreeTGADecoder( &decoder );
                                 return( -1 );
                         }
-                        StripAlpha( imageBuff, bCount );
-                        if ( fwrite( imageBuff, 1, bCount - sp->imageWidth, ofp ) !=
-                                        bCount - sp->imageWidth )
+                        SwizzleTGAPixels( imageBuff, imageBuff, sp->imageWidth,
+                                        &TGASwizzleStripAlpha );
+                        if ( packBuff )
                         {
-                                puts( "Error writing 24 bit image data." );
+                                p = (unsigned char *)packBuff;
+                                byteCount = optimal ?
+                                        RLEncodeRowOptimal( (char *)imageBuff, packBuff,
+                                                sp->imageWidth, 3 ) :
+                                        RLEncodeRow( (char *)imageBuff, packBuff,
+                                                sp->imageWidth, 3 );
+                        }
+                        else
+                        {
+                                p = imageBuff;
+                                byteCount = bCount - sp->imageWidth;
+                        }
+                        if ( (long)fwrite( p, 1, byteCount, ofp ) != byteCount )
+                        {
+                                jp->message = "Error writing 24 bit image data.";
+                                free( packBuff );
                                 free( imageBuff );
+                                FreeTGADecoder( &decoder );
                                 return( -1 );
                         }
                 }
+                free( packBuff );
         }
-        else if ( !unPack )
+        else if ( sp->imageType > 8 )
         {
-                packBuff = malloc( sp->imageWidth * (bytesPerPixel + 1) );
-                if ( packBuff == NULL )
+                /*
+                ** Rows are encoded in bands on the requested number of
+                ** threads and written in their original order.  When
+                ** repacking, the rows are decoded from the old packets
+                ** as they are needed, so the image is converted in a
+                ** single pass.
+                */
+                switch ( EncodeTGAImage( &decoder, ofp, threads,
+                                ( optimal ? TGA_ENCODE_OPTIMAL : 0 ) |
+                                ( narrow ? TGA_ENCODE_NARROW : 0 ) |
+                                ( dither ? TGA_ENCODE_DITHER : 0 ) ) )
                 {
-                        puts( "Error allocating encoded buffer." );
+                case 0:
+                        break;
+                case TGA_ENCODE_ERROR_READ:
+                        jp->message = rePack ? "Error reading RLE data." :
+                                "Error reading uncompressed data.";
+                        free( imageBuff );
+                        FreeTGADecoder( &decoder );
+                        return( -1 );
+                case TGA_ENCODE_ERROR_WRITE:
+                        jp->message = "Error writing RLE image data.";
+                        free( imageBuff );
+                        FreeTGADecoder( &decoder );
+                        return( -1 );
+                default:
+                        jp->message = "Error allocating encoded buffer.";
                         free( imageBuff );
+                        FreeTGADecoder( &decoder );
                         return( -1 );
                 }
-                for ( i = 0; i < sp->imageHeight; ++i )
+        }
+        else if ( threads > 1 && !narrow )
+        {
+                /*
+                ** Uncompress bands of the image data concurrently, then
+                ** write the whole image at once.  The bands start from
+                ** the rows of an index made by TGAINDEX when it is up
+                ** to date, rather than a pass over the packet headers.
+                */
+                if ( decoder.rle && jp->fileName != NULL )
+                        ReadTGAIndex( jp->fileName, &decoder );
+                image = NULL;
+                if ( DecodeTGAImageParallel( &decoder, &image, 0, 0, threads ) < 0 )
                 {
-                        if ( fread( imageBuff, 1, bCount, ifp ) != bCount )
-                        {
-                                puts( "Error reading uncompressed data." );
-                                free( imageBuff );
-                                free( packBuff );
-                                return( -1 );
-                        }
-                        rleCount = RLEncodeRow( imageBuff, packBuff, sp->imageWidth,
-                                                        bytesPerPixel );
-                        if ( fwrite( packBuff, 1, rleCount, ofp ) != rleCount )
-                        {
-                                puts( "Error writing RLE image data." );
-                                free( imageBuff );
-                                free( packBuff );
-                                return( -1 );
-                        }
+                        jp->message = "Error reading RLE data.";
+                        free( imageBuff );
+                        FreeTGADecoder( &decoder );
+                        return( -1 );
+                }
+                byteCount = (long) bCount * sp->imageHeight;
+                if ( (long)fwrite( image, 1, byteCount, ofp ) != byteCount )
+                {
+                        jp->message = "Error writing uncompressed data.";
+                        free( imageBuff );
+                        FreeTGADecoder( &decoder );
+                        return( -1 );
                 }
-                free( packBuff );
         }
         else
         {
                 /*
-                ** Uncompress image data
+                ** Uncompress image data, narrowing each row in place
+                ** when converting to 16 bit.
                 */
+                byteCount = narrow ? 2L * sp->imageWidth : bCount;
                 for ( i = 0; i < sp->imageHeight; ++i )
                 {
-                        if ( ReadRLERow(ifp, imageBuff, bCount, bytesPerPixel) < 0 )
+                        if ( DecodeTGARow( &decoder, imageBuff ) < 0 )
                         {
-                                puts("Error reading RLE data." );
+                                jp->message = isf.imageType > 8 ? "Error reading RLE data." :
+                                        "Error reading uncompressed data.";
                                 free( imageBuff );
+                                FreeTGADecoder( &decoder );
                                 return( -1 );
                         }
-                        if ( fwrite( imageBuff, 1, bCount, ofp ) != bCount )
+                        if ( narrow ) NarrowTGAPixels( imageBuff, imageBuff, sp->imageWidth,
+                                        decoder.pixelBytes, narrowFlags, i );
+                        if ( (long)fwrite( imageBuff, 1, byteCount, ofp ) != byteCount )
                         {
-                                puts("Error writing uncompressed data." );
+                                jp->message = "Error writing uncompressed data.";
                                 free( imageBuff );
+                                FreeTGADecoder( &decoder );
                                 return( -1 );
                         }
                 }
         }
         free( imageBuff );
+        FreeTGADecoder( &decoder );
 
         return( 0 );
 }
@@ -455,8 +1005,39 @@ int ParseArgs(int argc, char **argv)
                 if ( *p == '-' )
                 {
                         p++;
-                        if ( string_case_compare( p, "unpack" ) == 0 ) unPack = 1;
+                        if ( string_case_compare( p, "unpack" ) == 0 ) unPack = 1, rePack = 0;
+                        else if ( string_case_compare( p, "repack" ) == 0 ) rePack = 1, unPack = 0;
                         else if ( string_case_compare( p, "32to24" ) == 0 ) noAlpha = 1;
+                        else if ( string_case_compare( p, "expand" ) == 0 ) expandMap = 1;
+                        else if ( string_case_compare( p, "16to24" ) == 0 ) widenTo = 24, narrow = 0;
+                        else if ( string_case_compare( p, "16to32" ) == 0 ) widenTo = 32, narrow = 0;
+                        else if ( string_case_compare( p, "to16" ) == 0 ) narrow = 1, widenTo = 0;
+                        else if ( string_case_compare( p, "dither" ) == 0 ) dither = 1;
+                        else if ( string_case_compare( p, "correct" ) == 0 ) correct = 1;
+                        else if ( string_case_compare( p, "optimal" ) == 0 ) optimal = 1;
+                        else if ( string_case_compare( p, "auto" ) == 0 ) autoPack = 1;
+                        else if ( string_case_compare( p, "threads" ) == 0 && i + 1 < argc &&
+                                        atoi( argv[1] ) > 0 )
+                        {
+                                threads = atoi( *(++argv) );
+                                ++i;
+                        }
+                        else if ( string_case_compare( p, "j" ) == 0 && i + 1 < argc &&
+                                        atoi( argv[1] ) > 0 )
+                        {
+                                batch = atoi( *(++argv) );
+                                ++i;
+                        }
+                        else if ( string_case_compare( p, "i" ) == 0 && i + 1 < argc )
+                        {
+                                inName = *(++argv);
+                                ++i;
+                        }
+                        else if ( string_case_compare( p, "o" ) == 0 && i + 1 < argc )
+                        {
+                                outName = *(++argv);
+                                ++i;
+                        }
                         else if ( string_case_compare( p, "version" ) == 0 )
                         {
                                 puts( versionStr );
@@ -467,7 +1048,20 @@ int ParseArgs(int argc, char **argv)
                                 puts( "Usage: tgapack [options] [file1] [file2...]" );
                                 puts( "  where options can be:" );
                                 puts( "    -unpack\t\tuncompress image data" );
+                                puts( "    -repack\t\tre-encode compressed image data" );
                                 puts( "    -32to24\t\tconvert 32 bit image to 24 bit image" );
+                                puts( "    -expand\t\tconvert color mapped image to true color" );
+                                puts( "    -16to24\t\tconvert 16 bit image to 24 bit image" );
+                                puts( "    -16to32\t\tconvert 16 bit image to 32 bit image" );
+                                puts( "    -to16\t\tconvert 24 or 32 bit image to 16 bit image" );
+                                puts( "    -dither\t\tdither images converted to 16 bit" );
+                                puts( "    -correct\t\tapply color correction to image data" );
+                                puts( "    -optimal\t\tencode image data as small as possible" );
+                                puts( "    -auto\t\tonly compress images that become smaller" );
+                                puts( "    -threads n\t\tprocess image data using n threads" );
+                                puts( "    -j n\t\t\tprocess n files at a time" );
+                                puts( "    -i file\t\tread one image from file, - for stdin" );
+                                puts( "    -o file\t\twrite the result to file, - for stdout" );
                                 puts( "    -version\t\treport version number" );
                                 exit( 0 );
                         }
@@ -574,7 +1168,7 @@ void PrintTGAInfo(TGAFile *sp) /* TGA structure pointer */
         if ( sp->idLength )
         {
                 printf( "Image ID:\n  " );
-                puts( f.idString );
+                puts( sp->idString );
         }
 }
 
@@ -588,21 +1182,19 @@ char *SkipBlank(char *p)
 
 
 
-void StripAlpha(unsigned char *s, int n)
+/*
+** Step over options, and the values of options that take one, to
+** reach the next file name argument.
+*/
+char **SkipOptions(char **argv)
 {
-        int                             i;
-        unsigned char   *p;
-
-        /*
-        ** Copy the RGB components omitting the alpha.  Perform the
-        ** copy in its own buffer.  This algorithm is probably
-        ** specific to the 80x86 since byte orderring will be different
-        ** on a 680x0 processor.
-        */
-        p = s;
-        for ( i = 0; i < n; ++i )
+        while ( **argv == '-' )
         {
-                if ( ( i % 4) == 3 ) ++p;
-                else *s++ = *p++;
+                if ( ( string_case_compare( *argv + 1, "threads" ) == 0 ||
+                                string_case_compare( *argv + 1, "j" ) == 0 ) &&
+                                argv[1] != NULL ) argv++;
+                argv++;
         }
+        return( argv );
 }
+